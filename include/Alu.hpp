@@ -0,0 +1,52 @@
+#ifndef ALU_HPP
+#define ALU_HPP
+
+#include "Decoder.hpp"
+#include "Registers.hpp"
+#include <cstdint>
+
+// ADD, XOR, SUB and CMP: what each computes, which flags it sets and whether
+// it stores its result, defined once for the text handlers and the interpreter
+template <Opcode Op> struct Alu;
+
+template <> struct Alu<Opcode::Add> {
+    static constexpr const char* NAME = "ADD";
+    static constexpr char SYMBOL = '+';
+    static constexpr FlagOp FLAGS = FlagOp::Add;
+    static constexpr bool WRITES = true;
+    static uint32_t apply(uint32_t a, uint32_t b) { return a + b; }
+};
+
+template <> struct Alu<Opcode::Xor> {
+    static constexpr const char* NAME = "XOR";
+    static constexpr char SYMBOL = '^';
+    static constexpr FlagOp FLAGS = FlagOp::Logic;
+    static constexpr bool WRITES = true;
+    static uint32_t apply(uint32_t a, uint32_t b) { return a ^ b; }
+};
+
+template <> struct Alu<Opcode::Sub> {
+    static constexpr const char* NAME = "SUB";
+    static constexpr char SYMBOL = '-';
+    static constexpr FlagOp FLAGS = FlagOp::Sub;
+    static constexpr bool WRITES = true;
+    static uint32_t apply(uint32_t a, uint32_t b) { return a - b; }
+};
+
+template <> struct Alu<Opcode::Cmp> {
+    static constexpr const char* NAME = "CMP";
+    static constexpr char SYMBOL = '-';
+    static constexpr FlagOp FLAGS = FlagOp::Sub;
+    static constexpr bool WRITES = false;  // Only sets flags
+    static uint32_t apply(uint32_t a, uint32_t b) { return a - b; }
+};
+
+// Computes Op on a and b and records its flags at the operation's width
+template <Opcode Op>
+inline uint32_t aluExecute(Registers& regs, uint32_t a, uint32_t b, Width width = Width::Dword) {
+    uint32_t result = Alu<Op>::apply(a, b);
+    regs.recordFlags(Alu<Op>::FLAGS, a, b, result, width);
+    return result;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ASSEMBLER_HPP
+#define ASSEMBLER_HPP
+
+#include "Program.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Assembles a source file (LOAD, --program) into a Program and data bytes
+//
+// Each line is one program line as it would be typed, optionally preceded
+// by "label:" and followed by a "; comment"; lines starting with '#' are
+// comments too. A label names the address of the line it is on (or the
+// next one), and may be used wherever an operand takes a number:
+//   loop: SUB ECX 1
+//         JNE loop          ; JNE 00001007
+// Directives:
+//   .text / .data       switch between program lines and data
+//   .org addr           in .data, continue at addr
+//   .byte v, v, ...     8-bit values
+//   .dword v, v, ...    32-bit values (labels allowed)
+//   .ascii "text"       the characters of text
+// Program lines are laid out from CPU::PROGRAM_BASE; data from DATA_BASE
+// unless placed with .org. Keeping data well away from the program leaves
+// room for lines typed after LOAD, which are assembled after the last one.
+//
+// Two passes: the first lays everything out and fixes every label, the
+// second assembles each line with its labels written as 8-digit hex. Labels
+// take that width in both passes, so a line's size never depends on where a
+// label turns out to be.
+class Assembler {
+public:
+    static const uint32_t DATA_BASE = 0x00100000;  // Where .data starts without an .org
+
+    struct Chunk {
+        uint32_t addr;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct Output {
+        Program program;
+        std::vector<Chunk> data;
+    };
+
+    // False with error "line n: reason" if source does not assemble
+    static bool assemble(std::string_view source, uint32_t base, Output& out, std::string& error);
+    static bool assembleFile(const std::string& path, uint32_t base, Output& out, std::string& error);
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef BINARY_LOADER_HPP
+#define BINARY_LOADER_HPP
+
+#include "Memory.hpp"
+#include <string>
+#include <cstdint>
+
+// Loads IA-32 machine code (LOADBIN) for X86Decoder to run
+//
+// A static little-endian ELF32 executable (EM_386) has its PT_LOAD segments
+// placed at their virtual addresses and starts at its entry point; any other
+// file is a flat binary placed at base and entered at its first byte. As with
+// ImageFile, the file is mmap'd privately and every whole page of it lands in
+// Memory without a copy; only partial pages at segment edges are copied.
+class BinaryLoader {
+public:
+    struct Image {
+        uint32_t start;  // Lowest loaded address
+        uint32_t end;    // One past the highest; RUN stops when EIP leaves [start, end)
+        uint32_t entry;
+    };
+
+    static bool load(const std::string& path, uint32_t base, Memory& mem, Image& image, std::string& error);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "Decoder.hpp"
+#include "Memory.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Binary form of program lines, as stored in guest memory from CPU::PROGRAM_BASE
+//
+// Each record starts with its Opcode + 1, so zero-filled memory never decodes.
+// Integers are little-endian:
+//   MOV/MOVB/ADD/XOR/SUB/CMP  op, form (dst kind | src kind << 4), dst, src (only MOV may have both in memory)
+//   PUSH/POP                  op, register
+//   Jcc                       op, u32 target
+//   TEXT                      op, u16 length, the line itself
+// A register operand is its Reg number (1 byte), an immediate is a u32, and a
+// memory operand is the base Reg number (0xFF for an absolute address)
+// followed by a u32 displacement; with an index register the base byte has
+// bit 7 set (0xFE when there is no base) and is followed by the index Reg
+// number | log2(scale) << 6, then the displacement. Lines without a decoded
+// form (meta commands, malformed instructions) are kept verbatim as TEXT records.
+class Bytecode {
+public:
+    static const size_t MAX_TEXT = 0xFFFF - 3;  // Longer lines are truncated
+
+    static void assemble(std::string_view line, std::vector<uint8_t>& out);  // Appends the record to out
+    static Instruction decode(const Memory& mem, uint32_t addr);  // Opcode::Invalid if the bytes do not decode
+    static std::string text(const Memory& mem, uint32_t addr);   // The line of the TEXT record at addr
+};
+
+#endif
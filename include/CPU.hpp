@@ -3,35 +3,103 @@
 
 #include "Registers.hpp"
 #include "Memory.hpp"
+#include "Jit.hpp"
+#include "Optimizer.hpp"
+#include "Decoder.hpp"
+#include "BinaryLoader.hpp"
+#include "Assembler.hpp"
+#include "CommandLog.hpp"
+#include "Program.hpp"
+#include "Profiler.hpp"
 #include <string>
+#include <chrono>
 #include <vector>
+#include <map>
 #include <utility>
 
-// Forward declaration of CommandHandler
+// Forward declarations of CommandHandler and Interpreter
 class CommandHandler;
+class Interpreter;
+class RunControl;
 
 class CPU {
 public:
+    // Why step() returned
+    enum class RunExit : uint8_t {
+        Running,  // The budget or time limit ran out; step() again to go on
+        End,      // EIP left the program
+        Fault,    // EIP is on bytes that do not decode
+        Quit      // A QUIT line in the program
+    };
+
     CPU(Registers& r, Memory& m);
     ~CPU();  // Add destructor
     std::string execute(const std::string& cmd, uint32_t* memory_start_addr);
-    std::vector<std::pair<uint32_t, std::string>>& getHistory();
-    void clearHistory();
+    const CommandLog& log() const { return command_log; }
+    void clearHistory();  // Both the program and the log
     void runHistory();
+    void appendProgram(const std::string& line);
+    uint32_t record(const std::string& line);
+    void logCommand(const std::string& line);  // Logs a line without making it part of the program
+    void reassemble();
+    void programReplaced();
+    void sourceLoaded(Assembler::Output& source);
+    void binaryLoaded(const BinaryLoader::Image& image);
+    void checkpoint(const std::string& name);
+    bool restore(const std::string& name);
+    // RUN in slices: startRun(), step() until it stops returning Running, then stopRun()
+    bool startRun();  // Points EIP at the entry point; false if there is nothing to run
+    RunExit step(uint64_t budget, std::chrono::microseconds limit, uint32_t* memory_start_addr);  // limit 0: none
+    void stopRun();
+    uint64_t instructionCount() const;  // Instructions retired by the last (or current) RUN
+    void setJitMode(JitMode mode);
+    JitMode jitMode() const;
+    uint64_t jitMismatches() const;  // JIT CHECK differences found by the last RUN
+    void setOptMode(OptMode mode);
+    OptMode optMode() const;
+    void setProfiling(bool on);
+    bool profiling() const;
+    std::string profileReport(size_t top) const;  // Counts of the last (or current) profiled RUN
+    std::string profileFolded() const;
 
     Registers& regs;
     Memory& mem;
     bool is_running;
+    uint32_t run_rate;  // RUN speed in instructions per second; 0 runs unthrottled
+    RunControl* run_control;  // Set while the UI watches RUN from another thread; RUN publishes to it
 
-    static const uint32_t ZF = 0x40;  // Zero Flag
-    static const uint32_t SF = 0x80;  // Sign Flag
-    static const uint32_t OF = 0x800; // Overflow Flag
+    static const uint32_t CF = LazyFlags::CF;  // Carry Flag
+    static const uint32_t PF = LazyFlags::PF;  // Parity Flag
+    static const uint32_t AF = LazyFlags::AF;  // Auxiliary carry Flag
+    static const uint32_t ZF = LazyFlags::ZF;  // Zero Flag
+    static const uint32_t SF = LazyFlags::SF;  // Sign Flag
+    static const uint32_t OF = LazyFlags::OF;  // Overflow Flag
     static const uint32_t PROGRAM_BASE = 0x1000;
+    static const uint64_t CLOCK_CHECK = 1 << 14;  // Instructions step() runs between looks at the clock
 
 private:
-    std::vector<std::pair<uint32_t, std::string>> history;
+    // Saved machine state; memory pages are shared copy-on-write with the live image
+    struct Checkpoint {
+        Registers regs;
+        Memory::Snapshot mem;
+        Program program;
+        uint32_t program_end;
+        Isa isa;
+        BinaryLoader::Image binary;
+    };
+
+    Program program;  // Source and bytecode of each assembled line, for reassembly and SAVE
+    CommandLog command_log;  // What the History pane shows; not part of checkpoints
+    uint32_t program_end;  // Address just past the last assembled line; RUN stops when EIP reaches it
+    Isa isa;               // What RUN executes: the typed program, or a binary from LOADBIN
+    BinaryLoader::Image binary;  // Extent and entry point of the loaded binary (Isa::X86)
+    uint32_t run_start, run_end;  // Code range of the current RUN, set by startRun()
+    std::map<std::string, Checkpoint> checkpoints;
     CommandHandler* commandHandler;
+    Interpreter* interpreter;  // Executes the assembled program for RUN
+    Profiler profiler;  // Attached to the interpreter while PROFILE is on
 
+    uint32_t place(size_t line);
     std::string memview(uint32_t addr, const std::string& addr_str, uint32_t* memory_start_addr);
 
     // Declare CommandHandler as a friend class
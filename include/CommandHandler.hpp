@@ -3,8 +3,9 @@
 
 #include "Registers.hpp"  // For Registers
 #include "Memory.hpp"     // For Memory
-#include <functional>
-#include <map>
+#include "Mnemonic.hpp"   // For Mnemonic ids
+#include "OperandParser.hpp"  // For ParseError
+#include <array>
 #include <string>
 
 // Forward declaration of CPU to avoid circular dependency
@@ -19,15 +20,13 @@ private:
     CPU& cpu;          // Reference to CPU
     Registers& regs;   // Reference to CPU's registers
     Memory& mem;       // Reference to CPU's memory
-    std::map<std::string, std::function<std::string(const std::string&, uint32_t*)>> commandMap;
+    using Handler = std::string (CommandHandler::*)(const std::string&, uint32_t*);
+    std::array<Handler, static_cast<size_t>(Mnemonic::COUNT)> handlers;  // Indexed by Mnemonic
 
     // Command functions (unchanged)
     std::string cmdMov(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdMovb(const std::string& cmd, uint32_t* memory_start_addr);
-    std::string cmdAdd(const std::string& cmd, uint32_t* memory_start_addr);
-    std::string cmdXor(const std::string& cmd, uint32_t* memory_start_addr);
-    std::string cmdSub(const std::string& cmd, uint32_t* memory_start_addr);
-    std::string cmdCmp(const std::string& cmd, uint32_t* memory_start_addr);
+    template <Opcode Op> std::string cmdAlu(const std::string& cmd, uint32_t* memory_start_addr);  // ADD/XOR/SUB/CMP
     std::string cmdPush(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdPop(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdJe(const std::string& cmd, uint32_t* memory_start_addr);
@@ -36,16 +35,34 @@ private:
     std::string cmdJl(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdJge(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdJle(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdJa(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdJb(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdJae(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdJbe(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdRun(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdControl(const std::string& cmd, uint32_t* memory_start_addr);  // PAUSE/STEP/STOP
     std::string cmdClear(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdMemset(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdSettext(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdMemview(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdCheckpoint(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdRestore(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdRate(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdJit(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdOpt(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdProfile(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdSave(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdLoad(const std::string& cmd, uint32_t* memory_start_addr);
+    std::string cmdLoadbin(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdHelp(const std::string& cmd, uint32_t* memory_start_addr);
     std::string cmdQuit(const std::string& cmd, uint32_t* memory_start_addr);
 
-    // Helper function
-    bool parseMemoryAddress(const std::string& arg, std::string& reg_out, int32_t& offset_out);
+    // Helper functions
+    bool memoryAddress(std::string_view arg, uint32_t& addr, ParseError& error) const;
+    uint32_t address(const Operand& op) const;
+    static std::string where(const std::string& cmd, std::string_view arg, const ParseError& error);
+    std::string jump(const std::string& cmd, const char* name, Cond cond);
+    static std::string argumentText(const std::string& cmd);
 };
 
 #endif
@@ -0,0 +1,40 @@
+#ifndef COMMAND_LOG_HPP
+#define COMMAND_LOG_HPP
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// The lines typed in a session, as shown in the History pane
+// A ring of fixed-size records: once CAPACITY lines are held, each new one
+// overwrites the oldest, so memory stays bounded however long a session
+// runs. Lines longer than TEXT_BYTES are cut short here; the program
+// (CPU::program) keeps its lines in full.
+class CommandLog {
+public:
+    static const size_t CAPACITY = 4096;
+    static const size_t TEXT_BYTES = 59;  // Fills a record out to 64 bytes
+
+    struct Entry {
+        uint32_t addr;    // Where the line was assembled (or EIP, with a binary loaded)
+        uint8_t length;
+        char text[TEXT_BYTES];
+
+        std::string_view line() const { return std::string_view(text, length); }
+    };
+
+    CommandLog();
+    void push(uint32_t addr, std::string_view line);
+    void clear();
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    const Entry& recent(size_t age) const;  // 0 is the newest; age < size()
+    uint64_t pushed() const { return total; }  // Lines ever pushed, so a view can tell when it is stale
+
+private:
+    std::vector<Entry> entries;  // Grows to CAPACITY, then wraps
+    size_t next;                 // Slot the next push writes once full
+    uint64_t total;
+};
+
+#endif
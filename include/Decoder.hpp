@@ -0,0 +1,80 @@
+#ifndef DECODER_HPP
+#define DECODER_HPP
+
+#include "Registers.hpp"
+#include "Mnemonic.hpp"
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Operations with a decoded form; everything else (meta commands, malformed
+// lines) decodes to Text and is run through CommandHandler as before
+enum class Opcode : uint8_t {
+    Mov, Movb, Add, Xor, Sub, Cmp, Push, Pop,
+    Je, Jne, Jg, Jl, Jge, Jle, Ja, Jb, Jae, Jbe,  // Same order as Cond
+    Jmp, Call, Ret, Inc, Dec, Nop, Hlt,           // Only produced by X86Decoder
+    Text,
+    Invalid  // Bytes in memory that do not decode (see Bytecode)
+};
+
+enum class OperandKind : uint8_t { None, Reg, Imm, Mem };
+
+struct Operand {
+    OperandKind kind = OperandKind::None;
+    Reg reg = Reg::NONE;    // Reg: the register; Mem: base register, or NONE for an absolute address
+    Reg index = Reg::NONE;  // Mem: scaled index register, if any
+    uint8_t scale = 1;      // Mem: 1, 2, 4 or 8
+    uint32_t value = 0;     // Imm: the value; Mem: displacement or absolute address
+};
+
+// Which machine code RUN decodes
+enum class Isa : uint8_t {
+    Bytecode,  // Lines assembled by the emulator (see Bytecode)
+    X86        // A loaded IA-32 binary (see X86Decoder)
+};
+
+// How Optimizer rewrote an instruction within its block
+enum class Fold : uint8_t {
+    None,
+    Quiet,   // ADD/XOR/SUB whose flags are overwritten before anything reads them
+    Clear,   // XOR r r: r becomes zero without being read
+    Branch   // CMP/SUB that also performs the conditional jump right after it
+};
+
+// One program line parsed once into a compact record
+struct Instruction {
+    Opcode op = Opcode::Text;
+    Width width = Width::Dword;  // Operand size: flags are taken at it; byte operations access single memory bytes
+    Fold fold = Fold::None;
+    uint8_t handler = 0;  // Interpreter handler for this opcode, operand form and fold; set when its block is built
+    uint16_t length = 0;  // Encoded size in bytes; set when decoded from memory
+    Operand dst;  // Destination; the operand of PUSH/POP/INC/DEC; the target of Jcc/JMP/CALL
+    Operand src;  // Source; for RET, the bytes of arguments it pops
+
+    bool byte() const { return width == Width::Byte; }
+};
+
+// Width of a bytecode ADD/XOR/SUB/CMP: that of its destination register (AL is 8-bit,
+// AX 16-bit), or 32-bit into memory; other bytecode operations are always 32-bit
+inline Width bytecodeWidth(Opcode op, const Operand& dst) {
+    bool alu = op >= Opcode::Add && op <= Opcode::Cmp;
+    return alu && dst.kind == OperandKind::Reg ? Registers::width(dst.reg) : Width::Dword;
+}
+
+// Condition tested by a conditional jump opcode (Je..Jbe)
+inline Cond jumpCondition(Opcode op) {
+    return static_cast<Cond>(static_cast<uint8_t>(op) - static_cast<uint8_t>(Opcode::Je));
+}
+
+class Decoder {
+public:
+    static Instruction decode(std::string_view line);
+
+private:
+    static Opcode jumpOpcode(Mnemonic mnemonic);
+    static bool parseMemory(std::string_view arg, Operand& out);
+    static bool parseImmediate(std::string_view arg, Operand& out);
+    static bool parseRegister(std::string_view arg, Operand& out);
+};
+
+#endif
@@ -5,18 +5,39 @@
 #include "Registers.hpp"
 #include "Memory.hpp"
 #include "CPU.hpp"
+#include "RunControl.hpp"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 class Emulator {
 public:
     Emulator();
+    void loadImage(const std::string& path);
+    std::string loadProgram(const std::string& path);
+    std::string loadBinary(const std::string& path, uint32_t base);
+    void setRunRate(uint32_t rate);
+    void setJitMode(JitMode mode);
+    void setOptMode(OptMode mode);
+    void setProfile(size_t top, const std::string& folded_path);
     void run();
+    int runBatch(const std::string& program_path, const std::vector<std::pair<uint32_t, uint32_t>>& dumps);
 
 private:
-    Screen screen;
+    std::unique_ptr<Screen> screen;  // Created by run(); batch mode never touches ncurses
     Registers regs;
     Memory mem;
     CPU cpu;
     uint32_t memory_start_addr;
+    std::string startup_status;
+    size_t profile_top;  // Rows of the profile report printed after a batch run; 0 for none
+    std::string folded_path;  // Where a batch run writes its folded stacks, if anywhere
+    RunControl run_control;  // Steers a RUN started from the UI, which runs on its own thread
+
+    void render(const std::string& status);
+    std::string watchRun(bool paused, bool& quit);
+    void printState(const std::vector<std::pair<uint32_t, uint32_t>>& dumps) const;
 };
 
 #endif
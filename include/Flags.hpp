@@ -0,0 +1,98 @@
+#ifndef FLAGS_HPP
+#define FLAGS_HPP
+
+#include <cstdint>
+
+// Operation that last produced the arithmetic flags
+enum class FlagOp : uint8_t {
+    None,   // FLAGS holds an explicitly written value
+    Add,    // a + b
+    Sub,    // a - b (SUB and CMP)
+    Logic,  // Bitwise result; CF, OF and AF are clear
+    Inc,    // a + 1; CF is left as it was
+    Dec     // a - 1; CF is left as it was
+};
+
+// Operand size of an ALU operation, which its flags are taken at
+enum class Width : uint8_t { Dword, Word, Byte };
+
+// Conditions tested by conditional jumps
+enum class Cond : uint8_t {
+    E, NE,          // ZF / !ZF
+    G, L, GE, LE,   // Signed
+    A, B, AE, BE    // Unsigned
+};
+
+// Whether cond holds after CMP a b, decided from the operands instead of derived flags
+// LazyFlags::test after SUB/CMP and the fused compare-and-branch both use it
+inline bool compareHolds(Cond cond, uint32_t a, uint32_t b) {
+    auto sa = static_cast<int32_t>(a);
+    auto sb = static_cast<int32_t>(b);
+    switch (cond) {
+        case Cond::E: return a == b;
+        case Cond::NE: return a != b;
+        case Cond::G: return sa > sb;
+        case Cond::L: return sa < sb;
+        case Cond::GE: return sa >= sb;
+        case Cond::LE: return sa <= sb;
+        case Cond::A: return a > b;
+        case Cond::B: return a < b;
+        case Cond::AE: return a >= b;
+        default: return a <= b;  // BE
+    }
+}
+
+// Lazily evaluated FLAGS
+// ALU instructions only record their operands and result; individual flag
+// bits are derived when something asks for them, so a CMP followed by a
+// jump costs a compare and no FLAGS word is ever built.
+class LazyFlags {
+public:
+    static const uint32_t CF = 0x1;   // Carry Flag
+    static const uint32_t PF = 0x4;   // Parity Flag
+    static const uint32_t AF = 0x10;  // Auxiliary carry Flag
+    static const uint32_t ZF = 0x40;  // Zero Flag
+    static const uint32_t SF = 0x80;  // Sign Flag
+    static const uint32_t OF = 0x800; // Overflow Flag
+
+    LazyFlags() : op_(FlagOp::None), shift_(0), carry_(false), a_(0), b_(0), result_(0), value_(0) {}
+
+    // 8- and 16-bit operations are kept in the top bits, so sign, carry and
+    // overflow follow from the 32-bit rules and only PF/AF need to look for them
+    void record(FlagOp op, uint32_t a, uint32_t b, uint32_t result, Width width = Width::Dword) {
+        op_ = op;
+        shift_ = width == Width::Byte ? 24 : width == Width::Word ? 16 : 0;
+        a_ = a << shift_;
+        b_ = b << shift_;
+        result_ = result << shift_;
+    }
+    // INC/DEC (op Inc or Dec): flags as for adding/subtracting 1, except that CF keeps its value
+    void recordStep(FlagOp op, uint32_t a, uint32_t result, Width width) {
+        bool carry = cf();
+        record(op, a, 1, result, width);
+        carry_ = carry;
+    }
+    void set(uint32_t value) {
+        op_ = FlagOp::None;
+        value_ = value;
+    }
+
+    uint32_t value() const;  // Full FLAGS word
+    bool test(Cond cond) const;
+
+    bool zf() const { return op_ == FlagOp::None ? (value_ & ZF) != 0 : result_ == 0; }
+    bool sf() const { return op_ == FlagOp::None ? (value_ & SF) != 0 : (result_ >> 31) != 0; }
+    bool cf() const;
+    bool of() const;
+    bool pf() const;
+    bool af() const;
+
+private:
+    FlagOp op_;
+    uint8_t shift_;  // 24 or 16 when a_, b_ and result_ hold 8- or 16-bit values in their top bits
+    bool carry_;     // CF before the last INC/DEC
+    uint32_t a_, b_, result_;  // Operands and result of the last ALU operation
+    uint32_t value_;           // Explicit FLAGS value when op_ is None
+};
+
+#endif
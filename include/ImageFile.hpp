@@ -0,0 +1,50 @@
+#ifndef IMAGE_FILE_HPP
+#define IMAGE_FILE_HPP
+
+#include "Registers.hpp"
+#include "Memory.hpp"
+#include "Program.hpp"
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Versioned binary machine image (SAVE/LOAD)
+//
+// Layout, integers in host byte order (little-endian on x86):
+//   Header      magic "EMUIMAGE", version, counts, EIP, FLAGS
+//   Page index  page_count x u32 guest page address
+//   Registers   reg_count x { char name[8]; u32 value }
+//   Program     program_count x { u32 addr; u32 len; char text[len] }
+//   Pages       page_count x 4 KiB, starting at the next 4 KiB file boundary
+//
+// All-zero pages are omitted. On load the file is mmap'd privately and its
+// pages are installed directly into Memory, so page data is only faulted in
+// when the guest touches it and copied only when the guest writes it.
+class ImageFile {
+public:
+    static const uint32_t VERSION = 2;  // 2: the program is assembled into the saved pages
+
+    static bool save(const std::string& path, const Registers& regs, const Memory& mem,
+                     const Program& program, std::string& error);
+    static bool load(const std::string& path, Registers& regs, Memory& mem,
+                     Program& program, std::string& error);
+    static bool isImage(const std::string& path);  // Whether path starts with the image magic
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reg_count;
+        uint32_t page_count;
+        uint32_t program_count;
+        uint32_t eip;
+        uint32_t flags;
+    };
+    struct RegisterEntry {
+        char name[8];
+        uint32_t value;
+    };
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef INTERPRETER_HPP
+#define INTERPRETER_HPP
+
+#include "Decoder.hpp"
+#include "Registers.hpp"
+#include "Memory.hpp"
+#include "Jit.hpp"
+#include "Optimizer.hpp"
+#include "Profiler.hpp"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// Executes the program in memory for RUN
+// Instructions are decoded from their bytes (see Bytecode and X86Decoder,
+// depending on the Isa) into basic blocks
+// that are cached by start address and chained to their successors, so a
+// loop runs block to block without looking anything up or decoding again.
+// A write into a page holding a block drops it, so code that is patched
+// while it runs is decoded afresh. With the optimizer on, each block also
+// gets a peephole-optimized form (see Optimizer), run whenever the budget
+// lets it finish. With the JIT enabled, blocks that run often enough are
+// compiled to native code. With a Profiler attached, every instruction is
+// counted before it runs; that copy of the dispatch loop is a separate
+// instantiation, so counting costs nothing while PROFILE is off.
+class Interpreter {
+public:
+    // Why run() returned
+    enum class Exit : uint8_t {
+        End,     // EIP left the program
+        Text,    // EIP is on a TEXT record; run its line through CommandHandler
+        Fault,   // EIP is on bytes that do not decode
+        Budget   // The instruction budget ran out
+    };
+
+    Interpreter(Registers& r, Memory& m);
+    ~Interpreter();
+
+    void invalidateAll();
+    void setIsa(Isa isa);
+    void setOptMode(OptMode mode);
+    OptMode optMode() const { return opt_mode; }
+
+    Exit run(uint32_t code_start, uint32_t code_end, uint64_t budget);  // Runs while code_start <= EIP < code_end
+
+    uint64_t retired;  // Instructions fetched by run() since the counter was last reset
+    JitMode jit_mode;
+    uint64_t jit_mismatches;  // Check mode: compiled passes that disagreed with the interpreter
+    Profiler* profiler;  // Counts each instruction when set; blocks then run unoptimized and uncompiled
+
+    static const uint32_t JIT_THRESHOLD = 64;  // Runs of a block before it is compiled
+
+private:
+    // Straight-line decoded instructions ending at a jump, call, return or
+    // halt, an instruction that writes EIP, or just before a TEXT record,
+    // bytes that do not decode or the program end
+    struct Block {
+        uint32_t start;                       // Address of the first instruction
+        uint32_t bytes = 0;                   // Encoded size of insns; start + bytes is the fall-through
+        std::vector<Instruction> insns;       // Empty when start is on a TEXT record or undecodable bytes
+        std::vector<Instruction> optimized;   // insns after Optimizer; empty when it is off
+        Exit stop = Exit::Text;               // Empty blocks: why run() returns on entering them
+        bool dynamic = false;                 // Ends by writing EIP or an indirect branch; its successor is looked up each time
+        Block* next[2] = {nullptr, nullptr};  // Chained successors: fall-through, jump taken
+        uint32_t runs = 0;                    // Entries, counted until the JIT has looked at it
+        bool jit_tried = false;
+        Jit::Compiled native;
+    };
+
+    Registers& regs;
+    Memory& mem;
+    Isa isa;
+    OptMode opt_mode;
+    std::unordered_map<uint32_t, std::unique_ptr<Block>> blocks;  // By start address
+    std::vector<std::unique_ptr<Block>> dropped; // Invalidated mid-run; freed when run() is next entered
+    bool blocks_changed;                         // Set by invalidation so run() stops trusting its block
+    Jit jit;
+
+    Block* block(uint32_t addr, uint32_t code_end);
+    void dropBlocks(uint32_t first, uint32_t last);
+    template <bool Profile>
+    Exit execute(uint32_t code_start, uint32_t code_end, uint64_t budget);
+    void profile(const Instruction& insn);
+    Jit::Exit runNative(Block* b, uint64_t& budget, uint32_t code_start, uint32_t code_end);
+
+    uint32_t address(const Operand& op) const;
+    uint32_t load(const Operand& op, bool byte = false) const;
+    void store(const Operand& op, uint32_t val, bool byte = false);
+    template <Opcode Op, OperandKind Dst, OperandKind Src, Width W, bool Flags>
+    void alu(const Instruction& insn);
+    template <Opcode Op, OperandKind Dst, OperandKind Src>
+    bool compareAndBranch(const Instruction& insn);
+};
+
+#endif
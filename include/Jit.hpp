@@ -0,0 +1,58 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "Decoder.hpp"
+#include "Registers.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Whether RUN compiles hot blocks, and whether it cross-checks them
+enum class JitMode : uint8_t {
+    Off,    // Interpret everything
+    On,     // Run hot blocks as native code
+    Check   // Run hot blocks natively and interpreted, one pass at a time, and compare
+};
+
+// Native x86-64 code for hot basic blocks
+// A block qualifies when every instruction is MOV/ADD/SUB/XOR/CMP on 32-bit
+// general-purpose registers and immediates, optionally ending in a
+// conditional jump. Guest registers stay in the register file, which the
+// generated code addresses directly; host EFLAGS bits line up with the
+// guest's, so flags come from the native instructions themselves. A block
+// whose jump targets its own start loops without leaving native code.
+// On other hosts nothing compiles and every block stays interpreted.
+class Jit {
+public:
+    enum Exit : int {
+        FALL_THROUGH,  // EIP is the instruction after the block
+        TAKEN,         // EIP is the jump target
+        BUDGET         // A self-loop used up its passes; EIP is the block start
+    };
+
+    // Compiled code for one block; code is nullptr if the block does not qualify
+    struct Compiled {
+        int (*code)(void* context) = nullptr;
+        bool reads_flags = false;   // The jump tests flags set before the block
+        bool writes_flags = false;
+    };
+
+    Jit();
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool available();  // Whether this host can run generated code
+    static bool parseMode(const std::string& word, JitMode& mode);  // OFF/ON/CHECK, any case
+    static const char* modeName(JitMode mode);
+    Compiled compile(const std::vector<Instruction>& insns, uint32_t start_eip);
+    void reset();  // Discards all compiled code
+    Exit run(const Compiled& block, Registers& regs, uint64_t& passes);  // passes: in the limit, out the count run
+
+private:
+    uint8_t* buffer;  // Executable code buffer, mapped on first compile
+    size_t used;
+};
+
+#endif
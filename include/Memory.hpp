@@ -2,6 +2,10 @@
 #define MEMORY_HPP
 
 #include <map>
+#include <array>
+#include <vector>
+#include <memory>
+#include <functional>
 #include <string>
 #include <cstdint>
 
@@ -12,19 +16,99 @@ public:
     void setValue(uint32_t value);
     static const uint32_t STACK_TOP = 0xFFFFFFF0;  // Top of stack (unchanged)
     static const uint32_t STACK_BASE = 0xFF000000; // Bottom of stack (expanded)
+    static const uint32_t PAGE_SHIFT = 12;         // 4 KiB pages
+    static const uint32_t PAGE_SIZE = 1u << PAGE_SHIFT;
+    static const uint32_t TABLE_SHIFT = 10;        // 1024 pages per second-level table
+    static const uint32_t TABLE_SIZE = 1u << TABLE_SHIFT;
     void write(uint32_t addr, uint32_t val, bool is_byte = false);
     uint32_t read(uint32_t addr, bool is_byte = false) const;
     void erase(uint32_t addr);
+    bool push(uint32_t& esp, uint32_t val);
+    bool pop(uint32_t& esp, uint32_t& val);
     void clear();
     std::map<uint32_t, uint32_t> getAll() const;
-    std::map<uint32_t, uint8_t> getAllBytes() const; // Corrected: no Memory::
+    std::map<uint32_t, uint8_t> getAllBytes() const; // Full snapshot; prefer visit()/readBytes() for views
+    template <typename Visitor>
+    void visit(uint32_t addr, uint32_t len, Visitor&& fn) const;
+    void readBytes(uint32_t addr, uint8_t* out, uint32_t len) const;
+    void writeBytes(uint32_t addr, const uint8_t* data, uint32_t len);
     void writeText(uint32_t addr, const std::string& text);
     void memView(uint32_t address, size_t size = 6);
 
+    // Two-level page table: the top 10 address bits select a table, the next
+    // 10 select a page, the low 12 the byte. Untouched tables/pages stay null
+    // and read back as zero. Tables and pages are shared between the live
+    // image and its snapshots and copied on first write (copy-on-write).
+    //
+    // The stack segment [STACK_BASE, 4 GiB) bypasses the page table: its pages
+    // are one array indexed down from the top of memory, grown as the stack
+    // deepens, so PUSH/POP find theirs with a single index. They are shared
+    // and copied on first write like the others.
+    using Page = std::array<uint8_t, PAGE_SIZE>;
+    using PageTable = std::array<std::shared_ptr<Page>, TABLE_SIZE>;
+    using Directory = std::array<std::shared_ptr<PageTable>, TABLE_SIZE>;
+    struct Snapshot {
+        Directory directory;         // Shared with the live image (copy-on-write)
+        std::vector<std::shared_ptr<Page>> stack;  // Likewise
+    };
+    Snapshot snapshot() const;
+    void restore(const Snapshot& snap);
+    template <typename Visitor>
+    void forEachPage(Visitor&& fn) const;
+    void mapPage(uint32_t addr, std::shared_ptr<Page> page);
+
+    // Code watch: the first write to a page marked with watchCode() unmarks it
+    // and calls on_code_write(page_addr), so cached translations of the code
+    // in it can be dropped. Later writes to the page cost nothing extra.
+    void watchCode(uint32_t addr, uint32_t len);
+    void unwatchCode();
+    std::function<void(uint32_t)> on_code_write;
+
 private:
+    const uint8_t* pageFor(uint32_t addr) const;
+    uint8_t* pageForWrite(uint32_t addr);
+    static size_t stackIndex(uint32_t addr) { return static_cast<uint32_t>(~addr) >> PAGE_SHIFT; }  // Into stack_
+    uint8_t* stackForWrite(uint32_t addr);
+    void codeWritten(uint32_t addr);
+
     uint32_t value_;
-    std::map<uint32_t, uint32_t> mem;
+    Directory directory_;
+    std::vector<std::shared_ptr<Page>> stack_;  // stack_[i] is the page i pages below 4 GiB; null if untouched
+    std::vector<bool> code_pages_;  // One bit per page number; empty until something is watched
     std::map<uint32_t, Memory> memory_;
 };
 
+// Visits the bytes backing [addr, addr + len) without copying, one page-sized
+// run at a time, in address order. fn(run_addr, data, run_len) receives a
+// pointer into the page, or nullptr for runs in untouched (all-zero) pages.
+// The range wraps at 4 GiB like every other access.
+template <typename Visitor>
+void Memory::visit(uint32_t addr, uint32_t len, Visitor&& fn) const {
+    while (len > 0) {
+        uint32_t offset = addr & (PAGE_SIZE - 1);
+        uint32_t run = PAGE_SIZE - offset;  // Bytes left in this page
+        if (run > len) run = len;
+        const uint8_t* page = pageFor(addr);
+        fn(addr, page ? page + offset : nullptr, run);
+        addr += run;
+        len -= run;
+    }
+}
+
+// Calls fn(page_addr, page) for every allocated page in address order
+// Stack pages come last, since the stack segment tops the address space
+template <typename Visitor>
+void Memory::forEachPage(Visitor&& fn) const {
+    for (uint32_t t = 0; t < TABLE_SIZE; t++) {
+        if (!directory_[t]) continue;
+        for (uint32_t p = 0; p < TABLE_SIZE; p++) {
+            const auto& page = (*directory_[t])[p];
+            if (page) fn((t << (PAGE_SHIFT + TABLE_SHIFT)) | (p << PAGE_SHIFT), *page);
+        }
+    }
+    for (size_t i = stack_.size(); i-- > 0;) {
+        if (stack_[i]) fn(static_cast<uint32_t>(0u - ((i + 1) << PAGE_SHIFT)), *stack_[i]);
+    }
+}
+
 #endif
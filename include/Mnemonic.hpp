@@ -0,0 +1,30 @@
+#ifndef MNEMONIC_HPP
+#define MNEMONIC_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Every command word the emulator accepts, shared by the interactive
+// dispatcher (CommandHandler) and the decoder
+enum class Mnemonic : uint8_t {
+    MOV, MOVB, ADD, XOR, SUB, CMP, PUSH, POP,
+    JE, JZ, JNE, JNZ, JG, JL, JGE, JLE, JA, JB, JAE, JBE,
+    RUN, PAUSE, STEP, STOP, CLEAR, MEMSET, SETTEXT, MEMVIEW,
+    CHECKPOINT, RESTORE, RATE, JIT, OPT, PROFILE, SAVE, LOAD, LOADBIN, HELP, QUIT,
+    COUNT,
+    NONE = 0xFF
+};
+
+// Upper-case spellings, indexed by Mnemonic
+constexpr std::array<std::string_view, static_cast<size_t>(Mnemonic::COUNT)> MNEMONIC_NAMES = {
+    "MOV", "MOVB", "ADD", "XOR", "SUB", "CMP", "PUSH", "POP",
+    "JE", "JZ", "JNE", "JNZ", "JG", "JL", "JGE", "JLE", "JA", "JB", "JAE", "JBE",
+    "RUN", "PAUSE", "STEP", "STOP", "CLEAR", "MEMSET", "SETTEXT", "MEMVIEW",
+    "CHECKPOINT", "RESTORE", "RATE", "JIT", "OPT", "PROFILE", "SAVE", "LOAD", "LOADBIN", "HELP", "QUIT"
+};
+
+Mnemonic lookupMnemonic(std::string_view word);  // Case-insensitive; Mnemonic::NONE if unknown
+std::string_view firstWord(std::string_view line);
+
+#endif
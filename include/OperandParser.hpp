@@ -0,0 +1,47 @@
+#ifndef OPERAND_PARSER_HPP
+#define OPERAND_PARSER_HPP
+
+#include "Decoder.hpp"
+#include <string_view>
+#include <cstdint>
+
+// Where and why text failed to parse
+struct ParseError {
+    size_t pos = 0;              // Offset of the offending character in the text that was parsed
+    const char* message = "";    // Static string, e.g. "expected ']'"
+};
+
+// Splits command lines into words and parses their operands without
+// allocating or throwing; everything works on views into the caller's line.
+//
+// Operands:
+//   register   EAX, al, ...
+//   number     hex by default (1F, 0x1F), #31 for decimal, 'A' for a character
+//              ('\n', '\t', '\0', '\\' and '\'' escapes); a leading - negates
+//   memory     [base + index*scale + disp] with any of the parts left out and
+//              any number of +/- displacement terms, e.g. [1000], [EBX-4],
+//              [ESI + EDI*4 + 10], [4*ECX + 2000]. A lone register is the base;
+//              a second one, or one with a scale of 1, 2, 4 or 8, is the index.
+class OperandParser {
+public:
+    static const size_t MAX_WORDS = 4;
+
+    // A command word and its operands; missing words are empty
+    struct Words {
+        std::string_view word[MAX_WORDS];
+        size_t count = 0;
+
+        std::string_view operator[](size_t i) const { return i < count ? word[i] : std::string_view(); }
+    };
+
+    // Whitespace-separated words; a [...] group or a quoted string is one word
+    // even if it contains spaces. Words past MAX_WORDS are dropped.
+    static Words split(std::string_view line);
+
+    static bool parse(std::string_view text, Operand& out, ParseError& error);  // Register, number or memory
+    static bool parseRegister(std::string_view text, Operand& out, ParseError& error);
+    static bool parseNumber(std::string_view text, uint32_t& out, ParseError& error);
+    static bool parseMemory(std::string_view text, Operand& out, ParseError& error);
+};
+
+#endif
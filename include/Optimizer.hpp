@@ -0,0 +1,36 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include "Decoder.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Whether RUN optimizes decoded blocks, and whether it prints them
+enum class OptMode : uint8_t {
+    Off,   // Run blocks as decoded
+    On,    // Run the optimized form of each block
+    Dump   // As On, and write each optimized block to stderr when it is built
+};
+
+// Peephole pass over one basic block of decoded instructions
+// Rewrites are confined to the block and keep its instruction count, so
+// retired counts and EIP are unchanged; the state is exact at the block's
+// end (and across any memory write, which may drop the block) but flags
+// may be stale in between. The interpreter therefore only runs the
+// optimized form when the budget covers the whole block.
+//   CMP/SUB r, x + Jcc   fused into one compare-and-branch (Fold::Branch)
+//   XOR r r              a clear that does not read r (Fold::Clear), or
+//                        MOV r 0 if its flags are dead
+//   ADD/XOR/SUB          Fold::Quiet when their flags are dead
+//   CMP                  NOP when its flags are dead
+class Optimizer {
+public:
+    static bool parseMode(const std::string& word, OptMode& mode);  // OFF/ON/DUMP, any case
+    static const char* modeName(OptMode mode);
+
+    static std::vector<Instruction> optimize(const std::vector<Instruction>& insns);
+    static std::string dump(uint32_t start, const std::vector<Instruction>& insns);  // One line per instruction
+};
+
+#endif
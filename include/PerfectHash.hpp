@@ -0,0 +1,76 @@
+#ifndef PERFECT_HASH_HPP
+#define PERFECT_HASH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Case-insensitive name -> index table with no collisions
+// Built by a constexpr constructor that searches for a hash seed under which
+// every name lands in its own slot, so declaring an instance constexpr does
+// the search at compile time. find() is one hash, one slot read and one
+// comparison, and never allocates. Names must be given in upper case.
+template <size_t N>
+class PerfectHash {
+public:
+    static constexpr size_t SIZE = [] {
+        size_t size = 1;
+        while (size < 4 * N) size <<= 1;  // Sparse enough that a seed is found quickly
+        return size;
+    }();
+
+    constexpr explicit PerfectHash(const std::array<std::string_view, N>& names)
+        : names_(names), slots_(), seed_(0) {
+        static_assert(N < EMPTY, "Indexes must fit in a slot");
+        for (uint32_t seed = 1; seed < MAX_SEED && seed_ == 0; seed++) {
+            for (auto& slot : slots_) slot = EMPTY;
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; i++) {
+                uint8_t& slot = slots_[hash(names[i], seed) & (SIZE - 1)];
+                if (slot != EMPTY) collision = true;
+                else slot = static_cast<uint8_t>(i);
+            }
+            if (!collision) seed_ = seed;
+        }
+    }
+
+    // True once a collision-free seed was found (check with static_assert)
+    constexpr bool valid() const { return seed_ != 0; }
+
+    // Index of name in the constructor's list, or -1 if it is not there
+    constexpr int find(std::string_view name) const {
+        uint8_t index = slots_[hash(name, seed_) & (SIZE - 1)];
+        if (index == EMPTY) return -1;
+        std::string_view candidate = names_[index];
+        if (candidate.size() != name.size()) return -1;
+        for (size_t i = 0; i < name.size(); i++) {
+            if (upper(name[i]) != candidate[i]) return -1;
+        }
+        return index;
+    }
+
+private:
+    static constexpr uint8_t EMPTY = 0xFF;
+    static constexpr uint32_t MAX_SEED = 1u << 16;
+
+    static constexpr char upper(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+
+    // FNV-1a over the upper-cased name, seeded, with a final mix of the high bits
+    static constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : name) {
+            h ^= static_cast<uint8_t>(upper(c));
+            h *= 16777619u;
+        }
+        return h ^ (h >> 15);
+    }
+
+    std::array<std::string_view, N> names_;
+    std::array<uint8_t, SIZE> slots_;
+    uint32_t seed_;
+};
+
+#endif
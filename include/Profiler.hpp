@@ -0,0 +1,61 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "Decoder.hpp"
+#include "Program.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Per-address execution counts for RUN (PROFILE)
+//
+// One Counts record per byte of the code range, indexed by address - start,
+// so counting an instruction is an array update whatever the program's size
+// (only the addresses where instructions start are ever touched). Counts are
+// cleared when a RUN starts and kept after it ends for REPORT and FOLDED.
+//
+// Folded stacks ("frame;frame count" lines, as flamegraph.pl reads them)
+// follow CALL/RET when the program made any calls, each frame a function
+// entry address; otherwise each basic block is a frame under the entry point.
+class Profiler {
+public:
+    struct Counts {
+        uint64_t executed = 0;
+        uint64_t taken = 0;      // Conditional jumps taken, and every JMP, CALL and RET
+        uint64_t not_taken = 0;
+        uint64_t reads = 0;      // Memory operands and stack slots read
+        uint64_t writes = 0;
+        uint32_t target = 0;     // Where the last taken branch went
+    };
+
+    static const size_t DEFAULT_TOP = 10;  // Rows per table in a report
+
+    void reset(uint32_t start, uint32_t end, uint32_t entry);  // A RUN over [start, end) begins at entry
+    void count(uint32_t addr, const Instruction& insn);  // insn is about to run at addr
+    void branch(uint32_t addr, bool taken, uint32_t target);
+    void call(uint32_t target);
+    void ret();
+
+    uint64_t instructions() const { return total; }
+    // Top-n instructions and loops; program supplies the source of each line, if there is one
+    std::string report(size_t n, const Program* program) const;
+    std::string folded() const;
+
+private:
+    static const size_t MAX_DEPTH = 256;  // Deeper calls are charged to the deepest frame kept
+
+    uint32_t start = 0;
+    std::vector<Counts> counts;
+    uint64_t total = 0;
+    // Call stack and the instructions run under each one, updated only at CALL/RET
+    std::vector<uint32_t> stack;
+    size_t untracked = 0;    // Calls past MAX_DEPTH still to return
+    uint64_t charged = 0;    // Instructions already added to stack_counts
+    std::map<std::vector<uint32_t>, uint64_t> stack_counts;
+    bool calls = false;
+
+    void charge();
+};
+
+#endif
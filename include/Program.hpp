@@ -0,0 +1,56 @@
+#ifndef PROGRAM_HPP
+#define PROGRAM_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// The typed program: each line's address, source and assembled bytecode
+//
+// Stored as parallel arrays over a few shared buffers rather than one
+// object per line, so appending, copying (checkpoints), walking and
+// saving a program costs a handful of allocations whatever its length:
+//   addrs                    where each line was assembled
+//   token_begin / tokens     the line split at single spaces, as token ids
+//   code_begin / code_bytes  its Bytecode, back to back
+// Tokens are interned: each distinct one is stored once in token_text,
+// so the registers, values and mnemonics that repeat from line to line
+// cost 4 bytes per use. Splitting at every space and rejoining with one
+// gives back the line exactly, whatever its spacing or quoting.
+class Program {
+public:
+    Program();
+
+    void append(uint32_t addr, std::string_view line);  // Assembles line at addr
+    void clear();
+    void reserve(size_t lines, size_t text_bytes);
+
+    size_t size() const { return addrs.size(); }
+    bool empty() const { return addrs.empty(); }
+    uint32_t addr(size_t i) const { return addrs[i]; }
+    void appendLine(size_t i, std::string& out) const;  // Adds line i's source to out
+    std::string line(size_t i) const;
+    const uint8_t* code(size_t i) const { return code_bytes.data() + code_begin[i]; }
+    uint32_t codeLength(size_t i) const { return code_begin[i + 1] - code_begin[i]; }
+    uint32_t end(uint32_t start) const;  // Address just past the furthest line, and at least start
+
+private:
+    std::vector<uint32_t> addrs;
+    std::vector<uint32_t> token_begin;  // size() + 1 entries; line i is tokens[token_begin[i] .. token_begin[i + 1])
+    std::vector<uint32_t> tokens;
+    std::vector<uint32_t> code_begin;   // size() + 1 entries, likewise into code_bytes
+    std::vector<uint8_t> code_bytes;
+
+    // Interned tokens: token i is token_text[token_start[i] .. token_start[i + 1])
+    std::string token_text;
+    std::vector<uint32_t> token_start;
+    std::vector<uint32_t> slots;  // Open-addressed hash of token ids + 1; 0 is empty
+
+    uint32_t intern(std::string_view text);
+    std::string_view token(uint32_t id) const;
+    void place(uint32_t id);
+    void grow();
+};
+
+#endif
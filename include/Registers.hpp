@@ -1,20 +1,87 @@
 #ifndef REGISTERS_HPP
 #define REGISTERS_HPP
 
-#include <map>
+#include "Flags.hpp"
+#include <array>
 #include <string>
+#include <string_view>
 #include <cstdint> // Added for uint32_t
 
+// Register identifiers used by decoded instructions
+// General-purpose registers follow the IA-32 encoding order
+enum class Reg : uint8_t {
+    EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI,
+    AX, CX, DX, BX, SP, BP, SI, DI,
+    AL, CL, DL, BL, AH, CH, DH, BH,
+    ES, CS, SS, DS,
+    EIP, IP, FLAGS,
+    COUNT,
+    NONE = 0xFF
+};
+
+// Register file stored as a flat array of 32-bit slots
+// 16-bit and 8-bit registers are views (shift + mask) of their 32-bit slot,
+// so there is never anything to keep in sync. FLAGS is evaluated lazily.
 class Registers {
 public:
     Registers();
-    uint32_t get(const std::string& reg) const;
+    uint32_t get(const std::string& reg) const;  // Name lookup, for the command parser
     void set(const std::string& reg, uint32_t val);
-    const std::map<std::string, uint32_t>& getAll() const;
+    uint32_t get(Reg reg) const;
+    void set(Reg reg, uint32_t val);
+    void clear();
+    void recordFlags(FlagOp op, uint32_t a, uint32_t b, uint32_t result, Width width = Width::Dword) {
+        flags.record(op, a, b, result, width);
+    }
+    void recordStepFlags(FlagOp op, uint32_t a, uint32_t result, Width width) { flags.recordStep(op, a, result, width); }
+    bool test(Cond cond) const { return flags.test(cond); }
+
+    static Reg lookup(std::string_view name);  // Case-insensitive; Reg::NONE if unknown
+    static bool isRegister(std::string_view name);
+    static const char* name(Reg reg);
+    static Width width(Reg reg);  // Operand size of a register, for the flags of ALU operations on it
 
 private:
-    std::map<std::string, uint32_t> regs;
-    void sync(const std::string& reg, uint32_t val);
+    // Backing storage: the eight GPRs in encoding order, then ES, CS, SS, DS, EIP
+    static const int SLOT_COUNT = 13;
+    static_assert(SLOT_COUNT == static_cast<int>(Reg::AX) + (static_cast<int>(Reg::EIP) - static_cast<int>(Reg::ES)) + 1,
+                  "One slot per 32-bit GPR (EAX..EDI), segment register (ES..DS) and EIP");
+
+    struct View {
+        uint8_t slot;   // Index into values
+        uint8_t shift;  // Bit position of the view within the slot
+        uint32_t mask;  // Width of the view
+    };
+    static const View VIEWS[static_cast<int>(Reg::COUNT)];
+
+    std::array<uint32_t, SLOT_COUNT> values;
+    LazyFlags flags;
+
+    friend class Jit;  // Generated code addresses the slots directly
 };
 
+// Reads a register as a view of its backing slot
+inline uint32_t Registers::get(Reg reg) const {
+    if (reg == Reg::FLAGS) return flags.value();  // Materialized on demand
+    const View& view = VIEWS[static_cast<int>(reg)];
+    return (values[view.slot] >> view.shift) & view.mask;
+}
+
+// The width of the register's view; FLAGS counts as 32-bit
+inline Width Registers::width(Reg reg) {
+    uint32_t mask = VIEWS[static_cast<int>(reg)].mask;
+    return mask == 0xFF ? Width::Byte : mask == 0xFFFF ? Width::Word : Width::Dword;
+}
+
+// Writes a register, leaving the bits of its slot outside the view untouched
+inline void Registers::set(Reg reg, uint32_t val) {
+    if (reg == Reg::FLAGS) {
+        flags.set(val);  // An explicit write replaces any pending lazy state
+        return;
+    }
+    const View& view = VIEWS[static_cast<int>(reg)];
+    uint32_t& slot = values[view.slot];
+    slot = (slot & ~(view.mask << view.shift)) | ((val & view.mask) << view.shift);
+}
+
 #endif
@@ -0,0 +1,84 @@
+#ifndef RUN_CONTROL_HPP
+#define RUN_CONTROL_HPP
+
+#include "Registers.hpp"
+#include "Memory.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <cstdint>
+
+// Lets the UI thread watch and steer a RUN executing on a worker thread
+//
+// Control: PAUSE/STEP/STOP requests are made under a mutex and raise an
+// atomic flag that cmdRun checks between CPU::step() slices, so a running program pays
+// one relaxed load per slice; a paused RUN sleeps on a condition variable.
+//
+// State: cmdRun publishes the registers, the top of the stack and the
+// visible memory window into a seqlock at most every PUBLISH_INTERVAL. The
+// UI samples it without locking and retries if a publish overlapped, so
+// neither thread ever waits for the other.
+class RunControl {
+public:
+    enum class Action : uint8_t {
+        Continue,  // Run a full slice
+        Step,      // Run one instruction, then wait again
+        Stop       // End the RUN where it is
+    };
+
+    static const uint32_t STACK_BYTES = 40;       // The words Screen shows from ESP
+    static const uint32_t MAX_MEMORY_ROWS = 64;   // 16 bytes each
+    static constexpr std::chrono::microseconds SLICE{5000};  // Unthrottled run time between checks
+    static constexpr std::chrono::milliseconds PUBLISH_INTERVAL{10};
+
+    // A consistent copy of what the UI shows
+    struct Frame {
+        Registers regs;
+        uint32_t memory_addr;
+        uint8_t stack[STACK_BYTES];
+        uint8_t memory[MAX_MEMORY_ROWS * 16];
+        uint64_t retired;
+    };
+
+    RunControl();
+
+    // UI thread
+    void start(bool paused, uint32_t memory_rows);  // Before the worker starts; paused runs wait for STEP or resume()
+    void pause();
+    void resume();
+    void step();  // Pauses if running, then lets one instruction through
+    void stop();
+    bool paused() const;
+    bool sample(Frame& frame) const;  // false until the RUN has published once
+
+    // cmdRun (worker thread)
+    bool attention() const { return attention_.load(std::memory_order_relaxed); }
+    Action proceed();  // Waits while paused
+    void pace(std::chrono::microseconds delay);  // Sleeps between paced instructions; PAUSE/STEP/STOP cut it short
+    void publish(const Registers& regs, const Memory& mem, uint32_t memory_addr, uint64_t retired, bool force);
+
+private:
+    enum class State : uint8_t { Running, Paused, Stopping };
+
+    // Seqlock layout, in 32-bit words
+    static const size_t REG_WORDS = 14;  // EAX..EDI, ES, CS, SS, DS, EIP, FLAGS
+    static const size_t ADDR_WORD = REG_WORDS;
+    static const size_t STACK_WORD = ADDR_WORD + 1;
+    static const size_t MEMORY_WORD = STACK_WORD + STACK_BYTES / 4;
+    static const size_t RETIRED_WORD = MEMORY_WORD + MAX_MEMORY_ROWS * 4;  // Low half, then high
+    static const size_t WORD_COUNT = RETIRED_WORD + 2;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    State state;
+    uint32_t steps;  // STEPs not yet taken while paused
+    std::atomic<bool> attention_;  // state is not Running
+
+    uint32_t memory_rows;
+    std::chrono::steady_clock::time_point last_publish;  // Worker only
+    std::atomic<uint32_t> sequence;  // Odd while a publish is in progress; 0 before the first
+    std::atomic<uint32_t> words[WORD_COUNT];
+};
+
+#endif
@@ -6,19 +6,39 @@
 #include <vector> // Add this
 #include "Registers.hpp"
 #include "Memory.hpp"
+#include "CommandLog.hpp"
 
+// The ncurses UI
+// The update functions only redraw a pane when what it shows has changed
+// since it was last drawn, and only stage it (wnoutrefresh); present()
+// then sends everything staged to the terminal in one doupdate(), so a
+// frame costs one write of just the cells that differ.
 class Screen {
 public:
     Screen();
     ~Screen();
-    void updateRegisters(const std::map<std::string, uint32_t>& regs, const std::string& changed_reg);
+    void updateRegisters(const Registers& regs, const std::string& changed_reg);
     void updateStack(const Memory& mem, uint32_t esp);
-    void updateMemoryAndHistory(const std::map<uint32_t, uint8_t>& mem, uint32_t start_addr, const std::vector<std::pair<uint32_t, std::string>>& history);
+    void updateStack(uint32_t esp, const uint8_t* bytes);  // The 40 bytes at esp, already copied
+    void updateMemoryAndHistory(const Memory& mem, uint32_t start_addr, const CommandLog& log);
+    void updateMemory(uint32_t start_addr, const uint8_t* bytes);  // memoryRows() rows of 16 bytes, already copied
     void updateStatus(const std::string& msg);
-    std::string getInput();
+    int memoryRows() const;
+    void present();  // Ends a frame: writes all staged panes to the terminal
+    void updateHistory(const CommandLog& log);
+    void promptInput();  // Clears the input line for readInput
+    bool readInput(std::string& line, int timeout_ms);  // Takes at most one key into line (PgUp/PgDn scroll History); true on Enter
 
 private:
     WINDOW *reg_win, *stack_win, *input_win, *memory_win, *history_win, *status_rect_win;
+    // What each pane last drew, as compared by changed(); empty until first drawn
+    std::string reg_shown, stack_shown, memory_shown, history_shown, status_shown;
+
     void initWindow(WINDOW*& win, int height, int width, int start_y, int start_x, int color_pair, const std::string& title);
+    size_t history_scroll;  // Lines the History pane is scrolled back from the newest
+
+    void scrollHistory(bool older);
+    static bool changed(std::string& shown, std::string now);
+    static void clearPane(WINDOW* win, const char* title);
 };
 #endif
@@ -0,0 +1,21 @@
+#ifndef X86_DECODER_HPP
+#define X86_DECODER_HPP
+
+#include "Decoder.hpp"
+#include "Memory.hpp"
+#include <cstdint>
+
+// Decodes the IA-32 instructions RUN supports in a loaded binary
+// 32-bit code in a flat address space: MOV, ADD, SUB, XOR, CMP, INC, DEC,
+// PUSH, POP, JMP, CALL, RET, NOP, HLT and the Jcc forms that map onto Cond,
+// each with its 8-bit and 32-bit operand forms and full ModRM/SIB addressing.
+// Prefixes (operand size, segment override, LOCK/REP) and anything else
+// decode to Opcode::Invalid, which stops RUN.
+class X86Decoder {
+public:
+    static const uint32_t MAX_LENGTH = 11;  // Longest supported form: opcode, ModRM, SIB, disp32, imm32
+
+    static Instruction decode(const Memory& mem, uint32_t addr);
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include "Assembler.hpp"
+#include "Bytecode.hpp"
+#include "Decoder.hpp"
+#include "Mnemonic.hpp"
+#include "OperandParser.hpp"
+#include "Registers.hpp"
+#include <unordered_map>
+#include <fstream>
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+// A source line with its label and comment taken off
+struct Line {
+    uint32_t number;         // 1-based, for errors
+    std::string_view label;  // Empty if none
+    std::string_view body;   // Program line or directive; empty if the line only had a label or comment
+};
+
+using Symbols = std::unordered_map<std::string_view, uint32_t>;  // Label -> address
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool identStart(char c) {
+    return isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool identChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && isSpace(text.front())) text.remove_prefix(1);
+    while (!text.empty() && isSpace(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+// Length of the quoted string or character starting at text[0], closing quote included
+size_t quotedLength(std::string_view text) {
+    size_t i = 1;
+    while (i < text.size() && text[i] != text[0]) i += text[i] == '\\' ? 2 : 1;
+    return std::min(i + 1, text.size());
+}
+
+// Splits off the label and the comment; '#' only starts a comment at the start of a line (#10 is decimal)
+Line parseLine(uint32_t number, std::string_view text) {
+    Line line{number, {}, {}};
+    text = trim(text);
+    if (!text.empty() && text[0] == '#') return line;
+    for (size_t i = 0; i < text.size();) {
+        if (text[i] == '"' || text[i] == '\'') {
+            i += quotedLength(text.substr(i));
+        } else if (text[i] == ';') {
+            text = text.substr(0, i);
+            break;
+        } else {
+            i++;
+        }
+    }
+    text = trim(text);
+    if (!text.empty() && identStart(text[0])) {
+        size_t end = 1;
+        while (end < text.size() && identChar(text[end])) end++;
+        if (end < text.size() && text[end] == ':') {
+            line.label = text.substr(0, end);
+            text = trim(text.substr(end + 1));
+        }
+    }
+    line.body = text;
+    return line;
+}
+
+std::string hex(uint32_t value) {
+    char text[9];
+    snprintf(text, sizeof(text), "%08X", value);
+    return text;
+}
+
+std::string lineError(const Line& line, const std::string& reason) {
+    return "line " + std::to_string(line.number) + ": " + reason;
+}
+
+// Writes body to out with each label among its operands replaced by its address as 8 hex digits
+// Quoted text and numbers are copied as they are
+void substitute(std::string_view body, const Symbols& symbols, std::string& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < body.size() && !isSpace(body[i])) i++;  // The command word is never a label
+    out.append(body.substr(0, i));
+    while (i < body.size()) {
+        char c = body[i];
+        size_t len = 1;
+        if (c == '"' || c == '\'') {
+            len = quotedLength(body.substr(i));
+        } else if (isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            while (i + len < body.size() && identChar(body[i + len])) len++;
+            auto it = identStart(c) ? symbols.find(body.substr(i, len)) : symbols.end();
+            if (it != symbols.end()) {
+                out += hex(it->second);
+                i += len;
+                continue;
+            }
+        }
+        out.append(body.substr(i, len));
+        i += len;
+    }
+}
+
+// The comma-separated values of a .byte/.dword directive
+std::vector<std::string_view> splitValues(std::string_view args) {
+    std::vector<std::string_view> values;
+    while (true) {
+        size_t comma = args.find(',');
+        values.push_back(trim(args.substr(0, comma)));
+        if (comma == std::string_view::npos) break;
+        args = args.substr(comma + 1);
+    }
+    return values;
+}
+
+// The bytes of a .ascii string, with \n, \t, \0, \\ and \" escapes
+bool parseAscii(std::string_view args, std::vector<uint8_t>& out) {
+    if (args.size() < 2 || args.front() != '"' || quotedLength(args) != args.size() || args.back() != '"') return false;
+    for (size_t i = 1; i + 1 < args.size(); i++) {
+        char c = args[i];
+        if (c == '\\') {
+            c = args[++i];
+            c = c == 'n' ? '\n' : c == 't' ? '\t' : c == '0' ? '\0' : c;
+        }
+        out.push_back(static_cast<uint8_t>(c));
+    }
+    return true;
+}
+
+}  // namespace
+
+bool Assembler::assemble(std::string_view source, uint32_t base, Output& out, std::string& error) {
+    // Split into lines and collect the label names, so pass 1 knows which operands are labels
+    std::vector<Line> lines;
+    Symbols symbols;
+    uint32_t number = 0;
+    for (size_t start = 0; start < source.size();) {
+        size_t end = source.find('\n', start);
+        if (end == std::string_view::npos) end = source.size();
+        Line line = parseLine(++number, source.substr(start, end - start));
+        start = end + 1;
+        if (!line.label.empty()) {
+            if (Registers::isRegister(line.label)) {
+                error = lineError(line, "label " + std::string(line.label) + " is a register name");
+                return false;
+            }
+            if (!symbols.emplace(line.label, 0).second) {
+                error = lineError(line, "duplicate label " + std::string(line.label));
+                return false;
+            }
+        }
+        if (!line.label.empty() || !line.body.empty()) lines.push_back(line);
+    }
+
+    // Pass 1: lay out program lines and data, and fix every label
+    std::string text;
+    std::vector<uint8_t> code;
+    uint32_t addr = base;
+    uint32_t data_addr = DATA_BASE;
+    bool in_data = false;
+    for (const Line& line : lines) {
+        if (!line.label.empty()) symbols[line.label] = in_data ? data_addr : addr;
+        if (line.body.empty()) continue;
+        std::string_view word = firstWord(line.body);
+        std::string_view args = trim(line.body.substr(word.size()));
+        if (word[0] != '.') {
+            if (in_data) {
+                error = lineError(line, "program lines belong in .text");
+                return false;
+            }
+            substitute(line.body, symbols, text);  // Labels take 8 digits whatever their value
+            code.clear();
+            Bytecode::assemble(text, code);
+            addr += static_cast<uint32_t>(code.size());
+            if (addr > DATA_BASE) {
+                error = lineError(line, "program reaches .data at " + hex(DATA_BASE));
+                return false;
+            }
+        } else if (word == ".text" || word == ".data") {
+            in_data = word == ".data";
+        } else if (!in_data && (word == ".org" || word == ".byte" || word == ".dword" || word == ".ascii")) {
+            error = lineError(line, std::string(word) + " belongs in .data");
+            return false;
+        } else if (word == ".org") {
+            ParseError parse_error;
+            if (!OperandParser::parseNumber(args, data_addr, parse_error)) {
+                error = lineError(line, std::string(".org: ") + parse_error.message);
+                return false;
+            }
+        } else if (word == ".byte" || word == ".dword") {
+            data_addr += static_cast<uint32_t>(splitValues(args).size()) * (word == ".byte" ? 1 : 4);
+        } else if (word == ".ascii") {
+            code.clear();
+            if (!parseAscii(args, code)) {
+                error = lineError(line, ".ascii needs one \"quoted\" string");
+                return false;
+            }
+            data_addr += static_cast<uint32_t>(code.size());
+        } else {
+            error = lineError(line, "unknown directive " + std::string(word));
+            return false;
+        }
+    }
+
+    // Pass 2: assemble with the labels in place, and build the data
+    Output result;
+    addr = base;
+    data_addr = DATA_BASE;
+    in_data = false;
+    std::vector<uint8_t> bytes;
+    for (const Line& line : lines) {
+        if (line.body.empty()) continue;
+        std::string_view word = firstWord(line.body);
+        std::string_view args = trim(line.body.substr(word.size()));
+        if (word[0] != '.') {
+            substitute(line.body, symbols, text);
+            Mnemonic mnemonic = lookupMnemonic(word);
+            if (mnemonic >= Mnemonic::MOV && mnemonic <= Mnemonic::JBE && Decoder::decode(text).op == Opcode::Text) {
+                error = lineError(line, "invalid operands in " + std::string(line.body));
+                return false;
+            }
+            result.program.append(addr, text);
+            addr += result.program.codeLength(result.program.size() - 1);
+            continue;
+        }
+        if (word == ".text" || word == ".data") {
+            in_data = word == ".data";
+            continue;
+        }
+        if (word == ".org") {
+            ParseError parse_error;
+            OperandParser::parseNumber(args, data_addr, parse_error);  // Checked in pass 1
+            continue;
+        }
+        bytes.clear();
+        if (word == ".ascii") {
+            parseAscii(args, bytes);
+        } else {
+            bool dword = word == ".dword";
+            for (std::string_view value : splitValues(args)) {
+                uint32_t v;
+                ParseError parse_error;
+                auto it = symbols.find(value);
+                if (it != symbols.end()) {
+                    v = it->second;
+                } else if (!OperandParser::parseNumber(value, v, parse_error)) {
+                    error = lineError(line, std::string(word) + ": " + parse_error.message);
+                    return false;
+                }
+                if (!dword && v > 0xFF && v < 0xFFFFFF80) {  // -128..255
+                    error = lineError(line, ".byte: " + std::string(value) + " does not fit in a byte");
+                    return false;
+                }
+                for (int i = 0; i < (dword ? 4 : 1); i++) bytes.push_back(static_cast<uint8_t>(v >> (8 * i)));
+            }
+        }
+        if (result.data.empty() || result.data.back().addr + result.data.back().bytes.size() != data_addr) {
+            result.data.push_back(Chunk{data_addr, {}});
+        }
+        result.data.back().bytes.insert(result.data.back().bytes.end(), bytes.begin(), bytes.end());
+        data_addr += static_cast<uint32_t>(bytes.size());
+    }
+    out = std::move(result);
+    return true;
+}
+
+// Reads path whole and assembles it
+bool Assembler::assembleFile(const std::string& path, uint32_t base, Output& out, std::string& error) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string source(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    if (!in.read(source.data(), source.size())) {
+        error = "cannot read " + path;
+        return false;
+    }
+    return assemble(source, base, out, error);
+}
@@ -0,0 +1,149 @@
+#include "BinaryLoader.hpp"
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <fcntl.h>     // For open
+#include <sys/mman.h>  // For mmap/munmap
+#include <sys/stat.h>  // For fstat
+#include <unistd.h>    // For close
+
+namespace {
+
+const uint8_t ELF_MAGIC[4] = {0x7F, 'E', 'L', 'F'};
+const size_t ELF_HEADER_SIZE = 52;
+const size_t PROGRAM_HEADER_SIZE = 32;
+const uint16_t ET_EXEC = 2;
+const uint16_t EM_386 = 3;
+const uint32_t PT_LOAD = 1;
+
+// Part of the file to place in guest memory
+struct Segment {
+    uint64_t offset;  // In the file
+    uint32_t addr;
+    uint32_t filesz;
+    uint32_t memsz;   // The part past filesz is zero-filled
+};
+
+uint16_t get16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Reads the PT_LOAD segments of an ELF32 executable; false (with error set) if it is not one we can run
+bool parseElf(const uint8_t* data, size_t size, std::vector<Segment>& segments, uint32_t& entry, std::string& error) {
+    if (size < ELF_HEADER_SIZE || data[4] != 1 || data[5] != 1) {
+        error = "only 32-bit little-endian ELF files are supported";
+        return false;
+    }
+    if (get16(data + 16) != ET_EXEC || get16(data + 18) != EM_386) {
+        error = "only static i386 ELF executables are supported";
+        return false;
+    }
+    entry = get32(data + 24);
+    uint64_t phoff = get32(data + 28);
+    uint16_t phentsize = get16(data + 42);
+    uint16_t phnum = get16(data + 44);
+    if (phentsize < PROGRAM_HEADER_SIZE || phoff + static_cast<uint64_t>(phentsize) * phnum > size) {
+        error = "ELF program headers are truncated";
+        return false;
+    }
+    for (uint16_t i = 0; i < phnum; i++) {
+        const uint8_t* ph = data + phoff + static_cast<uint64_t>(i) * phentsize;
+        if (get32(ph) != PT_LOAD) continue;
+        Segment segment{get32(ph + 4), get32(ph + 8), get32(ph + 16), get32(ph + 20)};
+        if (segment.offset + segment.filesz > size || segment.filesz > segment.memsz) {
+            error = "ELF segment " + std::to_string(i) + " is truncated";
+            return false;
+        }
+        segments.push_back(segment);
+    }
+    if (segments.empty()) {
+        error = "ELF file has no loadable segments";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+// Maps path and places its code in memory, replacing everything there
+// Nothing is modified unless the whole file validates
+bool BinaryLoader::load(const std::string& path, uint32_t base, Memory& mem, Image& image, std::string& error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        error = path + " is empty";
+        return false;
+    }
+    size_t size = st.st_size;
+    // Private writable mapping, as in ImageFile::load: guest writes never reach the file
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    std::shared_ptr<uint8_t> mapping(static_cast<uint8_t*>(mapped), [size](uint8_t* p) { munmap(p, size); });
+    const uint8_t* data = mapping.get();
+
+    std::vector<Segment> segments;
+    uint32_t entry = base;
+    if (size >= sizeof(ELF_MAGIC) && std::memcmp(data, ELF_MAGIC, sizeof(ELF_MAGIC)) == 0) {
+        if (!parseElf(data, size, segments, entry, error)) return false;
+    } else {
+        if (size > Memory::STACK_BASE) {
+            error = path + " does not fit below the stack";
+            return false;
+        }
+        segments.push_back({0, base, static_cast<uint32_t>(size), static_cast<uint32_t>(size)});
+    }
+
+    uint64_t start = UINT64_MAX, end = 0;
+    for (const Segment& segment : segments) {
+        if (segment.memsz == 0) continue;
+        uint64_t segment_end = static_cast<uint64_t>(segment.addr) + segment.memsz;
+        if (segment_end > Memory::STACK_BASE) {
+            error = path + " does not fit below the stack";
+            return false;
+        }
+        start = std::min<uint64_t>(start, segment.addr);
+        end = std::max(end, segment_end);
+    }
+    if (start >= end) {
+        error = path + " has nothing to load";
+        return false;
+    }
+
+    mem.clear();
+    for (const Segment& segment : segments) {
+        // Whole pages of file data are shared with the mapping; the ragged edges are copied.
+        // Zero-fill needs nothing: cleared memory already reads as zero.
+        uint32_t addr = segment.addr;
+        const uint8_t* from = data + segment.offset;
+        uint32_t left = segment.filesz;
+        while (left > 0) {
+            uint32_t offset = addr & (Memory::PAGE_SIZE - 1);
+            uint32_t run = std::min(Memory::PAGE_SIZE - offset, left);
+            if (run == Memory::PAGE_SIZE) {
+                auto* page = reinterpret_cast<Memory::Page*>(const_cast<uint8_t*>(from));
+                mem.mapPage(addr, std::shared_ptr<Memory::Page>(mapping, page));
+            } else {
+                mem.writeBytes(addr, from, run);
+            }
+            addr += run;
+            from += run;
+            left -= run;
+        }
+    }
+    image = Image{static_cast<uint32_t>(start), static_cast<uint32_t>(end), entry};
+    return true;
+}
@@ -0,0 +1,166 @@
+#include "Bytecode.hpp"
+#include <algorithm>
+
+namespace {
+
+const uint8_t ABSOLUTE = 0xFF;  // Memory operand without a base register
+const uint8_t INDEXED = 0x80;   // Base byte flag: an index byte follows
+const uint8_t NO_BASE = 0x7E;   // Base of an indexed operand without a base register (0xFF is ABSOLUTE)
+const size_t MAX_INSN = 14;     // op, form, two 6-byte memory operands
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((v >> (i * 8)) & 0xFF);
+}
+
+uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void putOperand(std::vector<uint8_t>& out, const Operand& op) {
+    switch (op.kind) {
+        case OperandKind::Reg: out.push_back(static_cast<uint8_t>(op.reg)); break;
+        case OperandKind::Imm: put32(out, op.value); break;
+        case OperandKind::Mem:
+            if (op.index == Reg::NONE) {
+                out.push_back(op.reg == Reg::NONE ? ABSOLUTE : static_cast<uint8_t>(op.reg));
+            } else {
+                out.push_back(INDEXED | (op.reg == Reg::NONE ? NO_BASE : static_cast<uint8_t>(op.reg)));
+                uint8_t log2_scale = op.scale == 8 ? 3 : op.scale == 4 ? 2 : op.scale == 2 ? 1 : 0;
+                out.push_back(static_cast<uint8_t>(op.index) | log2_scale << 6);
+            }
+            put32(out, op.value);
+            break;
+        default: break;
+    }
+}
+
+bool validReg(uint8_t byte) {
+    return byte < static_cast<uint8_t>(Reg::COUNT);
+}
+
+// Reads an operand of the given kind at p; returns its size, or 0 if it is malformed
+size_t getOperand(const uint8_t* p, OperandKind kind, Operand& op) {
+    op.kind = kind;
+    switch (kind) {
+        case OperandKind::Reg:
+            if (!validReg(p[0])) return 0;
+            op.reg = static_cast<Reg>(p[0]);
+            return 1;
+        case OperandKind::Imm:
+            op.value = get32(p);
+            return 4;
+        case OperandKind::Mem: {
+            if (p[0] == ABSOLUTE || !(p[0] & INDEXED)) {
+                if (p[0] != ABSOLUTE && !validReg(p[0])) return 0;
+                op.reg = p[0] == ABSOLUTE ? Reg::NONE : static_cast<Reg>(p[0]);
+                op.value = get32(p + 1);
+                return 5;
+            }
+            uint8_t base = p[0] & ~INDEXED;
+            uint8_t index = p[1] & 0x3F;
+            if ((base != NO_BASE && !validReg(base)) || !validReg(index)) return 0;
+            op.reg = base == NO_BASE ? Reg::NONE : static_cast<Reg>(base);
+            op.index = static_cast<Reg>(index);
+            op.scale = static_cast<uint8_t>(1 << (p[1] >> 6));
+            op.value = get32(p + 2);
+            return 6;
+        }
+        default:
+            return 0;
+    }
+}
+
+}  // namespace
+
+// Encodes one program line onto the end of out; anything Decoder leaves as Text becomes a TEXT record
+void Bytecode::assemble(std::string_view line, std::vector<uint8_t>& out) {
+    Instruction insn = Decoder::decode(line);
+    out.push_back(static_cast<uint8_t>(insn.op) + 1);
+    switch (insn.op) {
+        case Opcode::Text: {
+            size_t len = std::min(line.size(), MAX_TEXT);
+            out.push_back(len & 0xFF);
+            out.push_back(len >> 8);
+            out.insert(out.end(), line.begin(), line.begin() + len);
+            break;
+        }
+        case Opcode::Push:
+        case Opcode::Pop:
+            out.push_back(static_cast<uint8_t>(insn.dst.reg));
+            break;
+        default:
+            if (insn.op >= Opcode::Je && insn.op <= Opcode::Jbe) {
+                put32(out, insn.dst.value);
+                break;
+            }
+            out.push_back(static_cast<uint8_t>(insn.dst.kind) | static_cast<uint8_t>(insn.src.kind) << 4);
+            putOperand(out, insn.dst);
+            putOperand(out, insn.src);
+            break;
+    }
+}
+
+// Decodes the record at addr, setting its length
+// Malformed records decode to Invalid with length 1
+Instruction Bytecode::decode(const Memory& mem, uint32_t addr) {
+    uint8_t bytes[MAX_INSN];
+    mem.readBytes(addr, bytes, sizeof(bytes));
+
+    Instruction insn;
+    Instruction invalid;
+    invalid.op = Opcode::Invalid;
+    invalid.length = 1;
+
+    if (bytes[0] == 0 || bytes[0] > static_cast<uint8_t>(Opcode::Text) + 1) return invalid;
+    insn.op = static_cast<Opcode>(bytes[0] - 1);
+    if (insn.op > Opcode::Jbe && insn.op < Opcode::Text) return invalid;  // x86-only operations
+    size_t length = 1;
+    switch (insn.op) {
+        case Opcode::Text:
+            length = 3 + (bytes[1] | (bytes[2] << 8));
+            break;
+        case Opcode::Push:
+        case Opcode::Pop:
+            length += getOperand(bytes + 1, OperandKind::Reg, insn.dst);
+            if (length == 1) return invalid;
+            break;
+        default: {
+            if (insn.op >= Opcode::Je && insn.op <= Opcode::Jbe) {
+                length += getOperand(bytes + 1, OperandKind::Imm, insn.dst);
+                break;
+            }
+            auto dst = static_cast<OperandKind>(bytes[1] & 0xF);
+            auto src = static_cast<OperandKind>(bytes[1] >> 4);
+            if (insn.op == Opcode::Movb) {
+                // Only the two forms the text handlers accept: [m] imm8 and r8 [m]
+                bool store = dst == OperandKind::Mem && src == OperandKind::Imm;
+                bool load = dst == OperandKind::Reg && src == OperandKind::Mem;
+                if (!store && !load) return invalid;
+            } else if ((dst != OperandKind::Reg && dst != OperandKind::Mem) || src == OperandKind::None || bytes[1] > 0x3F) {
+                return invalid;
+            } else if (insn.op != Opcode::Mov && dst == OperandKind::Mem && src == OperandKind::Mem) {
+                return invalid;  // Only MOV has a memory-to-memory form
+            }
+            size_t dst_len = getOperand(bytes + 2, dst, insn.dst);
+            if (!dst_len) return invalid;
+            size_t src_len = getOperand(bytes + 2 + dst_len, src, insn.src);
+            if (!src_len) return invalid;
+            if (insn.op == Opcode::Movb && dst == OperandKind::Reg && (insn.dst.reg < Reg::AL || insn.dst.reg > Reg::BH)) {
+                return invalid;
+            }
+            insn.width = bytecodeWidth(insn.op, insn.dst);
+            length += 1 + dst_len + src_len;
+            break;
+        }
+    }
+    insn.length = static_cast<uint16_t>(length);
+    return insn;
+}
+
+std::string Bytecode::text(const Memory& mem, uint32_t addr) {
+    uint8_t header[3];
+    mem.readBytes(addr, header, sizeof(header));
+    std::string line(header[1] | (header[2] << 8), '\0');
+    mem.readBytes(addr + 3, reinterpret_cast<uint8_t*>(&line[0]), static_cast<uint32_t>(line.size()));
+    return line;
+}
@@ -1,13 +1,19 @@
 #include "CPU.hpp"
 #include "CommandHandler.hpp"
+#include "Interpreter.hpp"
+#include "Bytecode.hpp"
 #include <sstream>
+#include <algorithm>
 
-CPU::CPU(Registers& r, Memory& m) : regs(r), mem(m), is_running(false), commandHandler(new CommandHandler(*this)) {
+CPU::CPU(Registers& r, Memory& m) : regs(r), mem(m), is_running(false), run_rate(1), run_control(nullptr), program_end(PROGRAM_BASE), isa(Isa::Bytecode),
+                                    binary{0, 0, 0}, run_start(PROGRAM_BASE), run_end(PROGRAM_BASE), commandHandler(new CommandHandler(*this)),
+                                    interpreter(new Interpreter(r, m)) {
     regs.set("EIP", PROGRAM_BASE);
 }
 
 CPU::~CPU() {
     delete commandHandler;
+    delete interpreter;
 }
 std::string CPU::execute(const std::string& cmd, uint32_t* memory_start_addr) {
     return commandHandler->executeCommand(cmd, memory_start_addr);
@@ -21,22 +27,205 @@ std::string CPU::memview(uint32_t addr, const std::string& addr_str, uint32_t* m
              mem.read(addr, true), mem.read(addr + 1, true), mem.read(addr + 2, true),
              mem.read(addr + 3, true), mem.read(addr + 4, true), mem.read(addr + 5, true));
     if (memory_start_addr) *memory_start_addr = addr;
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string command = "MEMVIEW " + addr_str;
-    history.push_back(std::make_pair(cmd_addr, command));
-    if (!is_running) regs.set("EIP", cmd_addr + 4);
+    if (!is_running) regs.set("EIP", record("MEMVIEW " + addr_str));
     return debug_str;
 }
 
-std::vector<std::pair<uint32_t, std::string>>& CPU::getHistory() {
-    return history;  // Return vector of address-command pairs
+// Clears the program and the command log
+void CPU::clearHistory() {
+    program.clear();
+    command_log.clear();
+    program_end = PROGRAM_BASE;  // The bytes stay in memory but RUN no longer reaches them
+    isa = Isa::Bytecode;  // Typing starts a new program even after LOADBIN
+    interpreter->setIsa(isa);
+    interpreter->invalidateAll();
 }
 
-// Clears command history
-void CPU::clearHistory() {
-    history.clear();  // Empty the history vector
+// A loaded binary runs from its entry point; a typed program from its first line
+bool CPU::startRun() {
+    bool x86 = isa == Isa::X86;
+    run_start = x86 ? binary.start : PROGRAM_BASE;
+    run_end = x86 ? binary.end : program_end;
+    if (run_end <= run_start) return false;
+    is_running = true;
+    interpreter->retired = 0;
+    interpreter->jit_mismatches = 0;
+    regs.set(Reg::EIP, x86 ? binary.entry : PROGRAM_BASE);
+    if (profiling()) profiler.reset(run_start, run_end, regs.get(Reg::EIP));
+    return true;
+}
+
+// Runs at most budget instructions (TEXT lines included), and with a limit, for about that long
+// Without a limit the interpreter keeps control until a line needs the text handlers
+CPU::RunExit CPU::step(uint64_t budget, std::chrono::microseconds limit, uint32_t* memory_start_addr) {
+    auto deadline = std::chrono::steady_clock::now() + limit;
+    while (budget > 0) {
+        uint64_t before = interpreter->retired;
+        Interpreter::Exit exit = interpreter->run(run_start, run_end, limit.count() ? std::min(budget, uint64_t(CLOCK_CHECK)) : budget);
+        budget -= std::min(budget, interpreter->retired - before);
+        if (exit == Interpreter::Exit::End) return RunExit::End;
+        if (exit == Interpreter::Exit::Fault) return RunExit::Fault;
+        if (exit == Interpreter::Exit::Text) {
+            uint32_t eip = regs.get(Reg::EIP);
+            if (profiling()) profiler.count(eip, Instruction{});
+            if (execute(Bytecode::text(mem, eip), memory_start_addr) == "QUIT") return RunExit::Quit;
+            regs.set(Reg::EIP, regs.get(Reg::EIP) + Bytecode::decode(mem, eip).length);
+        }
+        if (limit.count() && std::chrono::steady_clock::now() >= deadline) break;
+    }
+    return RunExit::Running;
+}
+
+void CPU::stopRun() {
+    is_running = false;
+}
+
+uint64_t CPU::instructionCount() const {
+    return interpreter->retired;
+}
+
+void CPU::setJitMode(JitMode mode) {
+    interpreter->jit_mode = mode;
+}
+
+JitMode CPU::jitMode() const {
+    return interpreter->jit_mode;
+}
+
+uint64_t CPU::jitMismatches() const {
+    return interpreter->jit_mismatches;
+}
+
+void CPU::setOptMode(OptMode mode) {
+    interpreter->setOptMode(mode);
+}
+
+OptMode CPU::optMode() const {
+    return interpreter->optMode();
+}
+
+void CPU::setProfiling(bool on) {
+    interpreter->profiler = on ? &profiler : nullptr;
+}
+
+bool CPU::profiling() const {
+    return interpreter->profiler != nullptr;
+}
+
+// A binary has no source lines to show beside its addresses
+std::string CPU::profileReport(size_t top) const {
+    return profiler.report(top, isa == Isa::Bytecode ? &program : nullptr);
+}
+
+std::string CPU::profileFolded() const {
+    return profiler.folded();
 }
 
 void CPU::runHistory() {
     // Unchanged
 }
+
+// Adds a line to the end of the program without executing it
+void CPU::appendProgram(const std::string& line) {
+    record(line);
+}
+
+// Assembles a line onto the end of the program and logs it
+// Returns the address after it, which is where EIP moves once it has run
+// With a binary loaded the line is only logged, at EIP, and EIP stays put
+uint32_t CPU::record(const std::string& line) {
+    if (isa == Isa::X86) {
+        command_log.push(regs.get(Reg::EIP), line);
+        return regs.get(Reg::EIP);
+    }
+    command_log.push(program_end, line);
+    program.append(program_end, line);
+    return place(program.size() - 1);
+}
+
+// Logs a line at the address the next program line would take (EIP with a binary loaded)
+void CPU::logCommand(const std::string& line) {
+    command_log.push(isa == Isa::X86 ? regs.get(Reg::EIP) : program_end, line);
+}
+
+// Writes every logged line back into memory, in order (CLEAR STACK wiped it)
+// A loaded binary has no source to rebuild from and stays lost
+void CPU::reassemble() {
+    if (isa == Isa::X86) return;
+    program_end = PROGRAM_BASE;
+    for (size_t i = 0; i < program.size(); i++) place(i);
+    interpreter->invalidateAll();
+}
+
+// Writes the bytecode of a program line to its address and extends the program past it
+uint32_t CPU::place(size_t line) {
+    uint32_t addr = program.addr(line);
+    mem.writeBytes(addr, program.code(line), program.codeLength(line));
+    uint32_t next = addr + program.codeLength(line);
+    program_end = std::max(program_end, next);
+    return next;
+}
+
+// Recomputes where the program ends after it was replaced (LOAD), and logs its lines so their addresses show
+// The code itself came with the memory image
+void CPU::programReplaced() {
+    program_end = program.end(PROGRAM_BASE);
+    isa = Isa::Bytecode;  // Images only ever hold typed programs
+    interpreter->setIsa(isa);
+    std::string line;
+    for (size_t i = 0; i < program.size(); i++) {
+        line.clear();
+        program.appendLine(i, line);
+        command_log.push(program.addr(i), line);
+    }
+    interpreter->invalidateAll();
+}
+
+// Starts over from an assembled source file (LOAD): the machine is reset as by CLEAR ALL,
+// then the program's bytecode and data are written to memory
+void CPU::sourceLoaded(Assembler::Output& source) {
+    regs.clear();
+    regs.set(Reg::ESP, Memory::STACK_TOP);
+    regs.set(Reg::EIP, PROGRAM_BASE);
+    mem.clear();
+    command_log.clear();
+    program = std::move(source.program);
+    for (size_t i = 0; i < program.size(); i++) place(i);
+    for (const Assembler::Chunk& chunk : source.data) {
+        mem.writeBytes(chunk.addr, chunk.bytes.data(), static_cast<uint32_t>(chunk.bytes.size()));
+    }
+    programReplaced();
+}
+
+// Switches RUN to the IA-32 code BinaryLoader placed in memory
+// The typed program is gone with the memory it lived in
+void CPU::binaryLoaded(const BinaryLoader::Image& image) {
+    program.clear();
+    program_end = PROGRAM_BASE;
+    isa = Isa::X86;
+    binary = image;
+    interpreter->setIsa(isa);
+    interpreter->invalidateAll();
+}
+
+// Saves registers, memory, program and run state under a name
+// Memory is captured by sharing pages, so the cost is independent of image size
+void CPU::checkpoint(const std::string& name) {
+    checkpoints[name] = Checkpoint{regs, mem.snapshot(), program, program_end, isa, binary};
+}
+
+// Rolls the machine back to a named checkpoint; returns false if it does not exist
+// Only done outside a RUN, so it leaves is_running alone even for a checkpoint taken inside one
+bool CPU::restore(const std::string& name) {
+    auto it = checkpoints.find(name);
+    if (it == checkpoints.end()) return false;
+    regs = it->second.regs;
+    mem.restore(it->second.mem);
+    program = it->second.program;
+    program_end = it->second.program_end;
+    isa = it->second.isa;
+    binary = it->second.binary;
+    interpreter->setIsa(isa);
+    interpreter->invalidateAll();
+    return true;
+}
@@ -1,898 +1,530 @@
 #include "CommandHandler.hpp"
 #include "CPU.hpp"
+#include "ImageFile.hpp"
+#include "BinaryLoader.hpp"
+#include "OperandParser.hpp"
+#include "Alu.hpp"
+#include "RunControl.hpp"
 #include <sstream>
+#include <fstream>
 #include <algorithm>
-#include <set>
 #include <cstring>
+#include <charconv>
 #include <unistd.h> // For usleep in cmdRun
 
 CommandHandler::CommandHandler(CPU& cpu_ref) : cpu(cpu_ref), regs(cpu_ref.regs), mem(cpu_ref.mem) {
-    // Initialize command map
-    commandMap["MOV"] = [this](const std::string& cmd, uint32_t* addr) { return cmdMov(cmd, addr); };
-    commandMap["MOVB"] = [this](const std::string& cmd, uint32_t* addr) { return cmdMovb(cmd, addr); };
-    commandMap["ADD"] = [this](const std::string& cmd, uint32_t* addr) { return cmdAdd(cmd, addr); };
-    commandMap["XOR"] = [this](const std::string& cmd, uint32_t* addr) { return cmdXor(cmd, addr); };
-    commandMap["SUB"] = [this](const std::string& cmd, uint32_t* addr) { return cmdSub(cmd, addr); };
-    commandMap["CMP"] = [this](const std::string& cmd, uint32_t* addr) { return cmdCmp(cmd, addr); };
-    commandMap["PUSH"] = [this](const std::string& cmd, uint32_t* addr) { return cmdPush(cmd, addr); };
-    commandMap["POP"] = [this](const std::string& cmd, uint32_t* addr) { return cmdPop(cmd, addr); };
-    commandMap["JE"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJe(cmd, addr); };
-    commandMap["JZ"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJe(cmd, addr); }; // Alias for JE
-    commandMap["JNE"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJne(cmd, addr); };
-    commandMap["JNZ"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJne(cmd, addr); }; // Alias for JNE
-    commandMap["JG"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJg(cmd, addr); };
-    commandMap["JL"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJl(cmd, addr); };
-    commandMap["JGE"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJge(cmd, addr); };
-    commandMap["JLE"] = [this](const std::string& cmd, uint32_t* addr) { return cmdJle(cmd, addr); };
-    commandMap["RUN"] = [this](const std::string& cmd, uint32_t* addr) { return cmdRun(cmd, addr); };
-    commandMap["CLEAR"] = [this](const std::string& cmd, uint32_t* addr) { return cmdClear(cmd, addr); };
-    commandMap["MEMSET"] = [this](const std::string& cmd, uint32_t* addr) { return cmdMemset(cmd, addr); };
-    commandMap["SETTEXT"] = [this](const std::string& cmd, uint32_t* addr) { return cmdSettext(cmd, addr); };
-    commandMap["MEMVIEW"] = [this](const std::string& cmd, uint32_t* addr) { return cmdMemview(cmd, addr); };
-    commandMap["HELP"] = [this](const std::string& cmd, uint32_t* addr) { return cmdHelp(cmd, addr); };
-    commandMap["QUIT"] = [this](const std::string& cmd, uint32_t* addr) { return cmdQuit(cmd, addr); };
+    // Initialize handler table (one entry per Mnemonic)
+    handlers[static_cast<size_t>(Mnemonic::MOV)] = &CommandHandler::cmdMov;
+    handlers[static_cast<size_t>(Mnemonic::MOVB)] = &CommandHandler::cmdMovb;
+    handlers[static_cast<size_t>(Mnemonic::ADD)] = &CommandHandler::cmdAlu<Opcode::Add>;
+    handlers[static_cast<size_t>(Mnemonic::XOR)] = &CommandHandler::cmdAlu<Opcode::Xor>;
+    handlers[static_cast<size_t>(Mnemonic::SUB)] = &CommandHandler::cmdAlu<Opcode::Sub>;
+    handlers[static_cast<size_t>(Mnemonic::CMP)] = &CommandHandler::cmdAlu<Opcode::Cmp>;
+    handlers[static_cast<size_t>(Mnemonic::PUSH)] = &CommandHandler::cmdPush;
+    handlers[static_cast<size_t>(Mnemonic::POP)] = &CommandHandler::cmdPop;
+    handlers[static_cast<size_t>(Mnemonic::JE)] = &CommandHandler::cmdJe;
+    handlers[static_cast<size_t>(Mnemonic::JZ)] = &CommandHandler::cmdJe; // Alias for JE
+    handlers[static_cast<size_t>(Mnemonic::JNE)] = &CommandHandler::cmdJne;
+    handlers[static_cast<size_t>(Mnemonic::JNZ)] = &CommandHandler::cmdJne; // Alias for JNE
+    handlers[static_cast<size_t>(Mnemonic::JG)] = &CommandHandler::cmdJg;
+    handlers[static_cast<size_t>(Mnemonic::JL)] = &CommandHandler::cmdJl;
+    handlers[static_cast<size_t>(Mnemonic::JGE)] = &CommandHandler::cmdJge;
+    handlers[static_cast<size_t>(Mnemonic::JLE)] = &CommandHandler::cmdJle;
+    handlers[static_cast<size_t>(Mnemonic::JA)] = &CommandHandler::cmdJa;
+    handlers[static_cast<size_t>(Mnemonic::JB)] = &CommandHandler::cmdJb;
+    handlers[static_cast<size_t>(Mnemonic::JAE)] = &CommandHandler::cmdJae;
+    handlers[static_cast<size_t>(Mnemonic::JBE)] = &CommandHandler::cmdJbe;
+    handlers[static_cast<size_t>(Mnemonic::RUN)] = &CommandHandler::cmdRun;
+    handlers[static_cast<size_t>(Mnemonic::PAUSE)] = &CommandHandler::cmdControl;
+    handlers[static_cast<size_t>(Mnemonic::STEP)] = &CommandHandler::cmdControl;
+    handlers[static_cast<size_t>(Mnemonic::STOP)] = &CommandHandler::cmdControl;
+    handlers[static_cast<size_t>(Mnemonic::CLEAR)] = &CommandHandler::cmdClear;
+    handlers[static_cast<size_t>(Mnemonic::MEMSET)] = &CommandHandler::cmdMemset;
+    handlers[static_cast<size_t>(Mnemonic::SETTEXT)] = &CommandHandler::cmdSettext;
+    handlers[static_cast<size_t>(Mnemonic::MEMVIEW)] = &CommandHandler::cmdMemview;
+    handlers[static_cast<size_t>(Mnemonic::CHECKPOINT)] = &CommandHandler::cmdCheckpoint;
+    handlers[static_cast<size_t>(Mnemonic::RESTORE)] = &CommandHandler::cmdRestore;
+    handlers[static_cast<size_t>(Mnemonic::RATE)] = &CommandHandler::cmdRate;
+    handlers[static_cast<size_t>(Mnemonic::JIT)] = &CommandHandler::cmdJit;
+    handlers[static_cast<size_t>(Mnemonic::OPT)] = &CommandHandler::cmdOpt;
+    handlers[static_cast<size_t>(Mnemonic::PROFILE)] = &CommandHandler::cmdProfile;
+    handlers[static_cast<size_t>(Mnemonic::SAVE)] = &CommandHandler::cmdSave;
+    handlers[static_cast<size_t>(Mnemonic::LOAD)] = &CommandHandler::cmdLoad;
+    handlers[static_cast<size_t>(Mnemonic::LOADBIN)] = &CommandHandler::cmdLoadbin;
+    handlers[static_cast<size_t>(Mnemonic::HELP)] = &CommandHandler::cmdHelp;
+    handlers[static_cast<size_t>(Mnemonic::QUIT)] = &CommandHandler::cmdQuit;
 }
 
 std::string CommandHandler::executeCommand(const std::string& cmd, uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op;
-    ss >> op;
-    std::string op_upper = op;
-    std::transform(op_upper.begin(), op_upper.end(), op_upper.begin(), ::toupper);
-
-    auto it = commandMap.find(op_upper);
-    if (it != commandMap.end()) {
-        return it->second(cmd, memory_start_addr);
+    Mnemonic op = lookupMnemonic(firstWord(cmd));
+    if (op != Mnemonic::NONE) {
+        return (this->*handlers[static_cast<size_t>(op)])(cmd, memory_start_addr);
     }
     return "Unknown command: " + cmd;
 }
 
 // Command implementations
+// An instruction line that does not parse is reported and not recorded, so it never reaches
+// the program; one that parses is recorded even if it fails (PUSH onto a full stack)
 std::string CommandHandler::cmdMov(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1, reg2;
-    ss >> op >> reg1 >> reg2;
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string reg1(words[1]), reg2(words[2]);
     std::string reg1_upper = reg1, reg2_upper = reg2;
     std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
     std::transform(reg2_upper.begin(), reg2_upper.end(), reg2_upper.begin(), ::toupper);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
 
     if (reg1[0] == '[') {  // Memory destination
-        std::string mem_reg;
-        int32_t offset;
-        if (parseMemoryAddress(reg1, mem_reg, offset)) {
-            uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
+        uint32_t addr;
+        ParseError error;
+        if (memoryAddress(words[1], addr, error)) {
             uint32_t val;
-            if (regs.getAll().count(reg2_upper)) {  // Register to memory
+            if (Registers::isRegister(reg2_upper)) {  // Register to memory
                 val = regs.get(reg2_upper);
                 mem.write(addr, val);
                 char debug_str[64];
                 snprintf(debug_str, sizeof(debug_str), "MOV [%08X] <- %08X", addr, val);
                 status = debug_str;
             } else {  // Immediate to memory
-                try {
-                    val = std::stoul(reg2_upper, nullptr, 16);
+                if (OperandParser::parseNumber(words[2], val, error)) {
                     mem.write(addr, val);
                     char debug_str[64];
                     snprintf(debug_str, sizeof(debug_str), "MOV [%08X] <- %08X", addr, val);
                     status = debug_str;
-                } catch (...) {
-                    status = "MOV failed: Invalid value";
+                } else {
+                    return "MOV failed: Invalid value" + where(cmd, words[2], error);
                 }
             }
         } else {
-            status = "MOV failed: Invalid memory address";
+            return "MOV failed: Invalid memory address" + where(cmd, words[1], error);
         }
-    } else if (regs.getAll().count(reg1_upper)) {  // Register destination
-        if (regs.getAll().count(reg2_upper)) {  // Register to register
+    } else if (Registers::isRegister(reg1_upper)) {  // Register destination
+        if (Registers::isRegister(reg2_upper)) {  // Register to register
             uint32_t val = regs.get(reg2_upper);
             regs.set(reg1_upper, val);
             char debug_str[64];
             snprintf(debug_str, sizeof(debug_str), "MOV %s <- %08X", reg1_upper.c_str(), val);
             status = debug_str;
         } else if (reg2[0] == '[') {  // Memory to register
-            std::string mem_reg;
-            int32_t offset;
-            if (parseMemoryAddress(reg2, mem_reg, offset)) {
-                uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
+            uint32_t addr;
+            ParseError error;
+            if (memoryAddress(words[2], addr, error)) {
                 uint32_t mem_val = mem.read(addr);
                 regs.set(reg1_upper, mem_val);
                 char debug_str[64];
                 snprintf(debug_str, sizeof(debug_str), "MOV %s <- [%08X] = %08X", reg1_upper.c_str(), addr, mem_val);
                 status = debug_str;
             } else {
-                status = "MOV failed: Invalid memory address";
+                return "MOV failed: Invalid memory address" + where(cmd, words[2], error);
             }
         } else {  // Immediate to register
-            try {
-                uint32_t val = std::stoul(reg2_upper, nullptr, 16);
+            uint32_t val;
+            ParseError error;
+            if (OperandParser::parseNumber(words[2], val, error)) {
                 regs.set(reg1_upper, val);
                 char debug_str[64];
                 snprintf(debug_str, sizeof(debug_str), "MOV %s <- %08X", reg1_upper.c_str(), val);
                 status = debug_str;
-            } catch (...) {
-                status = "MOV failed: Invalid value";
+            } else {
+                return "MOV failed: Invalid value" + where(cmd, words[2], error);
             }
         }
     } else {
-        status = "MOV failed: Invalid register";
+        return "MOV failed: Invalid register";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdMovb(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1, reg2;
-    ss >> op >> reg1 >> reg2;
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string reg1(words[1]), reg2(words[2]);
     std::string reg1_upper = reg1, reg2_upper = reg2;
     std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
     std::transform(reg2_upper.begin(), reg2_upper.end(), reg2_upper.begin(), ::toupper);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
 
     if (reg1[0] == '[') {  // Memory destination
-        std::string mem_reg;
-        int32_t offset;
-        if (parseMemoryAddress(reg1, mem_reg, offset)) {
-            uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
-            try {
-                uint32_t val = std::stoul(reg2_upper, nullptr, 16);
+        uint32_t addr;
+        ParseError error;
+        if (memoryAddress(words[1], addr, error)) {
+            uint32_t val;
+            if (OperandParser::parseNumber(words[2], val, error)) {
                 if (val > 0xFF) {
-                    status = "MOVB failed: Value exceeds byte size";
+                    return "MOVB failed: Value exceeds byte size";
                 } else {
                     mem.write(addr, val, true);
                     char debug_str[64];
                     snprintf(debug_str, sizeof(debug_str), "MOVB [%08X] <- %02X", addr, val);
                     status = debug_str;
                 }
-            } catch (...) {
-                status = "MOVB failed: Invalid value";
+            } else {
+                return "MOVB failed: Invalid value" + where(cmd, words[2], error);
             }
         } else {
-            status = "MOVB failed: Invalid memory address";
+            return "MOVB failed: Invalid memory address" + where(cmd, words[1], error);
         }
-    } else if (regs.getAll().count(reg1_upper)) {  // Byte register destination
-        std::set<std::string> byte_registers = {"AH", "AL", "BH", "BL", "CH", "CL", "DH", "DL"};
-        if (byte_registers.count(reg1_upper) == 0) {
-            status = "MOVB failed: Not a byte register";
+    } else if (Registers::isRegister(reg1_upper)) {  // Byte register destination
+        Reg reg1_id = Registers::lookup(reg1_upper);
+        if (reg1_id < Reg::AL || reg1_id > Reg::BH) {
+            return "MOVB failed: Not a byte register";
         } else if (reg2[0] == '[') {  // Memory to byte register
-            std::string mem_reg;
-            int32_t offset;
-            if (parseMemoryAddress(reg2, mem_reg, offset)) {
-                uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
+            uint32_t addr;
+            ParseError error;
+            if (memoryAddress(words[2], addr, error)) {
                 uint32_t mem_val = mem.read(addr, true);
                 regs.set(reg1_upper, mem_val);
                 char debug_str[64];
                 snprintf(debug_str, sizeof(debug_str), "MOVB %s <- [%08X] = %02X", reg1_upper.c_str(), addr, mem_val);
                 status = debug_str;
             } else {
-                status = "MOVB failed: Invalid memory address";
+                return "MOVB failed: Invalid memory address" + where(cmd, words[2], error);
             }
         } else {
-            status = "MOVB failed: Unsupported operand";
+            return "MOVB failed: Unsupported operand";
         }
     } else {
-        status = "MOVB failed: Invalid register";
-    }
-
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
-    return status;
-}
-
-std::string CommandHandler::cmdAdd(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1, reg2;
-    ss >> op >> reg1 >> reg2;
-    std::string reg1_upper = reg1, reg2_upper = reg2;
-    std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
-    std::transform(reg2_upper.begin(), reg2_upper.end(), reg2_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
-
-    if (reg1[0] == '[') {  // Memory operand
-        std::string mem_reg;
-        int32_t offset;
-        if (parseMemoryAddress(reg1, mem_reg, offset)) {
-            if (!regs.getAll().count(reg2_upper)) {
-                status = "ADD failed: Invalid register";
-            } else {
-                uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
-                uint32_t val1 = mem.read(addr);
-                uint32_t val2 = regs.get(reg2_upper);
-                int32_t signed_val1 = static_cast<int32_t>(val1);
-                int32_t signed_val2 = static_cast<int32_t>(val2);
-                int32_t signed_result = signed_val1 + signed_val2;
-                uint32_t result_val = static_cast<uint32_t>(signed_result);
-                uint32_t flags = 0;
-                if (result_val == 0) flags |= CPU::ZF;
-                if (signed_result < 0) flags |= CPU::SF;
-                if (((signed_val1 > 0 && signed_val2 > 0 && signed_result < 0) ||
-                     (signed_val1 < 0 && signed_val2 < 0 && signed_result > 0))) flags |= CPU::OF;
-                regs.set("FLAGS", flags);
-                mem.write(addr, result_val);
-                char debug_str[64];
-                snprintf(debug_str, sizeof(debug_str), "ADD [%08X]: %08X + %08X = %08X", addr, val1, val2, result_val);
-                status = debug_str;
-            }
-        } else {
-            status = "ADD failed: Invalid memory address";
-        }
-    } else if (regs.getAll().count(reg1_upper)) {  // Register operand
-        uint32_t val1 = regs.get(reg1_upper);
-        uint32_t val2;
-        if (regs.getAll().count(reg2_upper)) {
-            val2 = regs.get(reg2_upper);
-        } else {
-            try {
-                val2 = std::stoul(reg2_upper, nullptr, 16);
-            } catch (...) {
-                status = "ADD failed: Invalid operand";
-                return status;
-            }
-        }
-        int32_t signed_val1 = static_cast<int32_t>(val1);
-        int32_t signed_val2 = static_cast<int32_t>(val2);
-        int32_t signed_result = signed_val1 + signed_val2;
-        uint32_t result_val = static_cast<uint32_t>(signed_result);
-        uint32_t flags = 0;
-        if (result_val == 0) flags |= CPU::ZF;
-        if (signed_result < 0) flags |= CPU::SF;
-        if (((signed_val1 > 0 && signed_val2 > 0 && signed_result < 0) ||
-             (signed_val1 < 0 && signed_val2 < 0 && signed_result > 0))) flags |= CPU::OF;
-        regs.set("FLAGS", flags);
-        regs.set(reg1_upper, result_val);
-        char debug_str[64];
-        snprintf(debug_str, sizeof(debug_str), "ADD %s: %08X + %08X = %08X", reg1_upper.c_str(), val1, val2, result_val);
-        status = debug_str;
-    } else {
-        status = "ADD failed: Invalid register";
+        return "MOVB failed: Invalid register";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
-std::string CommandHandler::cmdXor(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1, reg2;
-    ss >> op >> reg1 >> reg2;
-    std::string reg1_upper = reg1, reg2_upper = reg2;
-    std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
-    std::transform(reg2_upper.begin(), reg2_upper.end(), reg2_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
-
-    if (reg1[0] == '[') {
-        std::string mem_reg;
-        int32_t offset;
-        if (parseMemoryAddress(reg1, mem_reg, offset)) {
-            if (!regs.getAll().count(reg2_upper)) {
-                status = "XOR failed: Invalid register";
-            } else {
-                uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
-                uint32_t val1 = mem.read(addr);
-                uint32_t val2 = regs.get(reg2_upper);
-                uint32_t result_val = val1 ^ val2;
-                int32_t signed_result = static_cast<int32_t>(result_val);
-                uint32_t flags = 0;
-                if (result_val == 0) flags |= CPU::ZF;
-                if (signed_result < 0) flags |= CPU::SF;
-                regs.set("FLAGS", flags);
-                mem.write(addr, result_val);
-                char debug_str[64];
-                snprintf(debug_str, sizeof(debug_str), "XOR [%08X]: %08X ^ %08X = %08X", addr, val1, val2, result_val);
-                status = debug_str;
-            }
-        } else {
-            status = "XOR failed: Invalid memory address";
+// ADD, XOR, SUB and CMP: [m] r, [m] imm, r r, r imm or r [m]
+template <Opcode Op>
+std::string CommandHandler::cmdAlu(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    using Traits = Alu<Op>;
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string name = Traits::NAME;
+    Operand dst, src;
+    ParseError error;
+
+    if (!words[1].empty() && words[1][0] == '[') {  // Memory operand
+        if (!OperandParser::parseMemory(words[1], dst, error)) {
+            return name + " failed: Invalid memory address" + where(cmd, words[1], error);
         }
-    } else if (regs.getAll().count(reg1_upper)) {
-        uint32_t val1 = regs.get(reg1_upper);
-        uint32_t val2;
-        if (regs.getAll().count(reg2_upper)) {
-            val2 = regs.get(reg2_upper);
-        } else {
-            try {
-                val2 = std::stoul(reg2_upper, nullptr, 16);
-            } catch (...) {
-                status = "XOR failed: Invalid operand";
-                return status;
+        if (!OperandParser::parseRegister(words[2], src, error)) {
+            if (!OperandParser::parseNumber(words[2], src.value, error)) {
+                return name + " failed: Invalid operand" + where(cmd, words[2], error);
             }
+            src.kind = OperandKind::Imm;
         }
-        uint32_t result_val = val1 ^ val2;
-        int32_t signed_result = static_cast<int32_t>(result_val);
-        uint32_t flags = 0;
-        if (result_val == 0) flags |= CPU::ZF;
-        if (signed_result < 0) flags |= CPU::SF;
-        regs.set("FLAGS", flags);
-        regs.set(reg1_upper, result_val);
-        char debug_str[64];
-        snprintf(debug_str, sizeof(debug_str), "XOR %s: %08X ^ %08X = %08X", reg1_upper.c_str(), val1, val2, result_val);
-        status = debug_str;
-    } else {
-        status = "XOR failed: Invalid register";
-    }
-
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
-    return status;
-}
-
-std::string CommandHandler::cmdSub(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1, reg2;
-    ss >> op >> reg1 >> reg2;
-    std::string reg1_upper = reg1, reg2_upper = reg2;
-    std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
-    std::transform(reg2_upper.begin(), reg2_upper.end(), reg2_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
-
-    if (reg1[0] == '[') {
-        std::string mem_reg;
-        int32_t offset;
-        if (parseMemoryAddress(reg1, mem_reg, offset)) {
-            if (!regs.getAll().count(reg2_upper)) {
-                status = "SUB failed: Invalid register";
-            } else {
-                uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
-                uint32_t val1 = mem.read(addr);
-                uint32_t val2 = regs.get(reg2_upper);
-                int32_t signed_val1 = static_cast<int32_t>(val1);
-                int32_t signed_val2 = static_cast<int32_t>(val2);
-                int32_t signed_result = signed_val1 - signed_val2;
-                uint32_t result_val = static_cast<uint32_t>(signed_result);
-                uint32_t flags = 0;
-                if (result_val == 0) flags |= CPU::ZF;
-                if (signed_result < 0) flags |= CPU::SF;
-                if (((signed_val1 > 0 && signed_val2 < 0 && signed_result < 0) ||
-                     (signed_val1 < 0 && signed_val2 > 0 && signed_result > 0))) flags |= CPU::OF;
-                regs.set("FLAGS", flags);
-                mem.write(addr, result_val);
-                char debug_str[64];
-                snprintf(debug_str, sizeof(debug_str), "SUB [%08X]: %08X - %08X = %08X", addr, val1, val2, result_val);
-                status = debug_str;
+    } else if (OperandParser::parseRegister(words[1], dst, error)) {  // Register operand
+        if (!words[2].empty() && words[2][0] == '[') {
+            if (!OperandParser::parseMemory(words[2], src, error)) {
+                return name + " failed: Invalid memory address" + where(cmd, words[2], error);
             }
-        } else {
-            status = "SUB failed: Invalid memory address";
-        }
-    } else if (regs.getAll().count(reg1_upper)) {
-        uint32_t val1 = regs.get(reg1_upper);
-        uint32_t val2;
-        if (regs.getAll().count(reg2_upper)) {
-            val2 = regs.get(reg2_upper);
-        } else {
-            try {
-                val2 = std::stoul(reg2_upper, nullptr, 16);
-            } catch (...) {
-                status = "SUB failed: Invalid operand";
-                return status;
+        } else if (!OperandParser::parseRegister(words[2], src, error)) {
+            if (!OperandParser::parseNumber(words[2], src.value, error)) {
+                return name + " failed: Invalid operand" + where(cmd, words[2], error);
             }
+            src.kind = OperandKind::Imm;
         }
-        int32_t signed_val1 = static_cast<int32_t>(val1);
-        int32_t signed_val2 = static_cast<int32_t>(val2);
-        int32_t signed_result = signed_val1 - signed_val2;
-        uint32_t result_val = static_cast<uint32_t>(signed_result);
-        uint32_t flags = 0;
-        if (result_val == 0) flags |= CPU::ZF;
-        if (signed_result < 0) flags |= CPU::SF;
-        if (((signed_val1 > 0 && signed_val2 < 0 && signed_result < 0) ||
-             (signed_val1 < 0 && signed_val2 > 0 && signed_result > 0))) flags |= CPU::OF;
-        regs.set("FLAGS", flags);
-        regs.set(reg1_upper, result_val);
-        char debug_str[64];
-        snprintf(debug_str, sizeof(debug_str), "SUB %s: %08X - %08X = %08X", reg1_upper.c_str(), val1, val2, result_val);
-        status = debug_str;
     } else {
-        status = "SUB failed: Invalid register";
+        return name + " failed: Invalid register";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
+    uint32_t addr = dst.kind == OperandKind::Mem ? address(dst) : 0;
+    uint32_t val1 = dst.kind == OperandKind::Mem ? mem.read(addr) : regs.get(dst.reg);
+    uint32_t val2 = src.kind == OperandKind::Reg ? regs.get(src.reg)
+                  : src.kind == OperandKind::Imm ? src.value : mem.read(address(src));
+    // Flags at the destination register's width, as RUN takes them (see bytecodeWidth)
+    uint32_t result_val = aluExecute<Op>(regs, val1, val2, bytecodeWidth(Op, dst));
+    if constexpr (Traits::WRITES) {
+        if (dst.kind == OperandKind::Mem) mem.write(addr, result_val);
+        else regs.set(dst.reg, result_val);
     }
-    return status;
-}
-
-std::string CommandHandler::cmdCmp(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1, reg2;
-    ss >> op >> reg1 >> reg2;
-    std::string reg1_upper = reg1, reg2_upper = reg2;
-    std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
-    std::transform(reg2_upper.begin(), reg2_upper.end(), reg2_upper.begin(), ::toupper);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
-
-    if (reg1[0] == '[') {
-        std::string mem_reg;
-        int32_t offset;
-        if (parseMemoryAddress(reg1, mem_reg, offset)) {
-            if (!regs.getAll().count(reg2_upper)) {
-                status = "CMP failed: Invalid register";
-            } else {
-                uint32_t addr = mem_reg.empty() ? offset : (regs.get(mem_reg) + offset);
-                uint32_t val1 = mem.read(addr);
-                uint32_t val2 = regs.get(reg2_upper);
-                int32_t signed_val1 = static_cast<int32_t>(val1);
-                int32_t signed_val2 = static_cast<int32_t>(val2);
-                int32_t signed_result = signed_val1 - signed_val2;
-                uint32_t flags = 0;
-                if (signed_result == 0) flags |= CPU::ZF;
-                if (signed_result < 0) flags |= CPU::SF;
-                if (((signed_val1 > 0 && signed_val2 < 0 && signed_result < 0) ||
-                     (signed_val1 < 0 && signed_val2 > 0 && signed_result > 0))) flags |= CPU::OF;
-                regs.set("FLAGS", flags);
-                std::stringstream ss;
-                ss << "CMP [" << std::hex << addr << "] - " << val2
-                   << ": ZF=" << ((flags & CPU::ZF) != 0)
-                   << " SF=" << ((flags & CPU::SF) != 0)
-                   << " OF=" << ((flags & CPU::OF) != 0)
-                   << " FLAGS=" << flags;
-                status = ss.str();
-            }
-        } else {
-            status = "CMP failed: Invalid memory address";
-        }
-    } else if (regs.getAll().count(reg1_upper)) {
-        uint32_t val1 = regs.get(reg1_upper);
-        uint32_t val2;
-        if (regs.getAll().count(reg2_upper)) {
-            val2 = regs.get(reg2_upper);
-        } else {
-            try {
-                val2 = std::stoul(reg2_upper, nullptr, 16);
-            } catch (...) {
-                status = "CMP failed: Invalid operand";
-                return status;
-            }
-        }
-        int32_t signed_val1 = static_cast<int32_t>(val1);
-        int32_t signed_val2 = static_cast<int32_t>(val2);
-        int32_t signed_result = signed_val1 - signed_val2;
-        uint32_t flags = 0;
-        if (signed_result == 0) flags |= CPU::ZF;
-        if (signed_result < 0) flags |= CPU::SF;
-        if (((signed_val1 > 0 && signed_val2 < 0 && signed_result < 0) ||
-             (signed_val1 < 0 && signed_val2 > 0 && signed_result > 0))) flags |= CPU::OF;
-        regs.set("FLAGS", flags);
+    if constexpr (Op == Opcode::Cmp) {
+        uint32_t flags = regs.get(Reg::FLAGS);
         std::stringstream ss;
-        ss << "CMP " << reg1 << " - " << std::hex << val2
+        ss << "CMP ";
+        if (dst.kind == OperandKind::Mem) ss << "[" << std::hex << addr << "]";
+        else ss << words[1];
+        ss << " - " << std::hex << val2
            << ": ZF=" << ((flags & CPU::ZF) != 0)
            << " SF=" << ((flags & CPU::SF) != 0)
+           << " CF=" << ((flags & CPU::CF) != 0)
            << " OF=" << ((flags & CPU::OF) != 0)
            << " FLAGS=" << flags;
         status = ss.str();
     } else {
-        status = "CMP failed: Invalid register";
+        char debug_str[64];
+        if (dst.kind == OperandKind::Mem) {
+            snprintf(debug_str, sizeof(debug_str), "%s [%08X]: %08X %c %08X = %08X",
+                     Traits::NAME, addr, val1, Traits::SYMBOL, val2, result_val);
+        } else {
+            snprintf(debug_str, sizeof(debug_str), "%s %s: %08X %c %08X = %08X",
+                     Traits::NAME, Registers::name(dst.reg), val1, Traits::SYMBOL, val2, result_val);
+        }
+        status = debug_str;
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdPush(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string reg1_upper = reg1;
-    std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
+    OperandParser::Words words = OperandParser::split(cmd);
+    Operand src;
+    ParseError error;
+    if (!OperandParser::parseRegister(words[1], src, error)) {
+        return "PUSH failed: Invalid register" + where(cmd, words[1], error);
+    }
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
-
-    if (regs.getAll().count(reg1_upper)) {
-        uint32_t val = regs.get(reg1_upper);
-        uint32_t esp = regs.get("ESP");
-        if (esp > mem.STACK_BASE) {
-            esp -= 4;
-            mem.write(esp, val);
-            regs.set("ESP", esp);
-            char debug_str[64];
-            snprintf(debug_str, sizeof(debug_str), "Pushed %08X to %08X, new ESP=%08X", val, esp, regs.get("ESP"));
-            status = debug_str;
-        } else {
-            status = "PUSH failed: ESP <= STACK_BASE";
-        }
+    uint32_t val = regs.get(src.reg);
+    uint32_t esp = regs.get(Reg::ESP);
+    if (mem.push(esp, val)) {
+        regs.set(Reg::ESP, esp);
+        char debug_str[64];
+        snprintf(debug_str, sizeof(debug_str), "Pushed %08X to %08X, new ESP=%08X", val, esp, regs.get(Reg::ESP));
+        status = debug_str;
     } else {
-        status = "PUSH failed: Invalid register";
+        status = "PUSH failed: ESP <= STACK_BASE";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdPop(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string reg1_upper = reg1;
-    std::transform(reg1_upper.begin(), reg1_upper.end(), reg1_upper.begin(), ::toupper);
+    OperandParser::Words words = OperandParser::split(cmd);
+    Operand dst;
+    ParseError error;
+    if (!OperandParser::parseRegister(words[1], dst, error)) {
+        return "POP failed: Invalid register" + where(cmd, words[1], error);
+    }
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
-
-    if (regs.getAll().count(reg1_upper)) {
-        uint32_t esp = regs.get("ESP");
-        if (esp <= mem.STACK_TOP - 4) {
-            uint32_t val = mem.read(esp);
-            esp += 4;
-            regs.set("ESP", esp);
-            regs.set(reg1_upper, val);
-            mem.erase(esp - 4);
-            mem.erase(esp - 3);
-            mem.erase(esp - 2);
-            mem.erase(esp - 1);
-            char debug_str[64];
-            snprintf(debug_str, sizeof(debug_str), "POP %s: %08X from %08X, new ESP=%08X", reg1_upper.c_str(), val, esp - 4, esp);
-            status = debug_str;
-        } else {
-            status = "POP failed: Stack empty or overflow";
-        }
+    uint32_t esp = regs.get(Reg::ESP);
+    uint32_t val;
+    if (mem.pop(esp, val)) {
+        regs.set(Reg::ESP, esp);
+        regs.set(dst.reg, val);
+        char debug_str[64];
+        snprintf(debug_str, sizeof(debug_str), "POP %s: %08X from %08X, new ESP=%08X", Registers::name(dst.reg), val, esp - 4, esp);
+        status = debug_str;
     } else {
-        status = "POP failed: Invalid register";
+        status = "POP failed: Stack empty or overflow";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdJe(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string addr_upper = reg1;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
-
-    if (!reg1.empty()) {
-        try {
-            uint32_t target_addr = std::stoul(addr_upper, nullptr, 16);
-            uint32_t flags = regs.get("FLAGS");
-            std::stringstream ss;
-            ss << "JE: FLAGS=" << std::hex << flags
-               << " ZF=" << CPU::ZF
-               << " Cond=" << ((flags & CPU::ZF) != 0)
-               << " EIP=" << cmd_addr
-               << " Target=" << target_addr;
-            status = ss.str();
-
-            if (flags & CPU::ZF) {
-                regs.set("EIP", target_addr);
-                status += " Jumped to " + reg1;
-            } else {
-                status += " No jump";
-                regs.set("EIP", cmd_addr + 6); // Assuming 6-byte instruction
-            }
-        } catch (...) {
-            status = "JE failed: Invalid address";
-        }
-    } else {
-        status = "JE failed: Missing address";
-    }
-
-    if (!cpu.is_running) cpu.history.push_back({cmd_addr, cmd});
-    return status;
+    return jump(cmd, "JE", Cond::E);
 }
 
 std::string CommandHandler::cmdJne(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string addr_upper = reg1;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
-
-    if (!reg1.empty()) {
-        try {
-            uint32_t target_addr = std::stoul(addr_upper, nullptr, 16);
-            if (!(regs.get("FLAGS") & CPU::ZF)) {
-                regs.set("EIP", target_addr);
-                status = "JNE jumped to " + reg1;
-            } else {
-                status = "JNE no jump";
-                if (!cpu.is_running) regs.set("EIP", cmd_addr + 4);
-            }
-        } catch (...) {
-            status = "JNE failed: Invalid address";
-        }
-    } else {
-        status = "JNE failed: Missing address";
-    }
-
-    if (!cpu.is_running) cpu.history.push_back({cmd_addr, cmd});
-    return status;
+    return jump(cmd, "JNE", Cond::NE);
 }
 
 std::string CommandHandler::cmdJg(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string addr_upper = reg1;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
-
-    if (!reg1.empty()) {
-        try {
-            uint32_t target_addr = std::stoul(addr_upper, nullptr, 16);
-            bool zf = regs.get("FLAGS") & CPU::ZF;
-            bool sf = regs.get("FLAGS") & CPU::SF;
-            bool of = regs.get("FLAGS") & CPU::OF;
-            if (!zf && (sf == of)) {
-                regs.set("EIP", target_addr);
-                status = "JG jumped to " + reg1;
-            } else {
-                status = "JG no jump";
-                if (!cpu.is_running) regs.set("EIP", cmd_addr + 4);
-            }
-        } catch (...) {
-            status = "JG failed: Invalid address";
-        }
-    } else {
-        status = "JG failed: Missing address";
-    }
-
-    if (!cpu.is_running) cpu.history.push_back({cmd_addr, cmd});
-    return status;
+    return jump(cmd, "JG", Cond::G);
 }
 
 std::string CommandHandler::cmdJl(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string addr_upper = reg1;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
-
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
+    return jump(cmd, "JL", Cond::L);
+}
 
-    if (!reg1.empty()) {
-        try {
-            uint32_t target_addr = std::stoul(addr_upper, nullptr, 16);
-            bool sf = regs.get("FLAGS") & CPU::SF;
-            bool of = regs.get("FLAGS") & CPU::OF;
-            if (sf != of) {
-                regs.set("EIP", target_addr);
-                status = "JL jumped to " + reg1;
-            } else {
-                status = "JL no jump";
-                if (!cpu.is_running) regs.set("EIP", cmd_addr + 4);
-            }
-        } catch (...) {
-            status = "JL failed: Invalid address";
-        }
-    } else {
-        status = "JL failed: Missing address";
-    }
+std::string CommandHandler::cmdJge(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    return jump(cmd, "JGE", Cond::GE);
+}
 
-    if (!cpu.is_running) cpu.history.push_back({cmd_addr, cmd});
-    return status;
+std::string CommandHandler::cmdJle(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    return jump(cmd, "JLE", Cond::LE);
 }
 
-std::string CommandHandler::cmdJge(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string addr_upper = reg1;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
+std::string CommandHandler::cmdJa(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    return jump(cmd, "JA", Cond::A);
+}
 
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
+std::string CommandHandler::cmdJb(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    return jump(cmd, "JB", Cond::B);
+}
 
-    if (!reg1.empty()) {
-        try {
-            uint32_t target_addr = std::stoul(addr_upper, nullptr, 16);
-            bool sf = regs.get("FLAGS") & CPU::SF;
-            bool of = regs.get("FLAGS") & CPU::OF;
-            if (sf == of) {
-                regs.set("EIP", target_addr);
-                status = "JGE jumped to " + reg1;
-            } else {
-                status = "JGE no jump";
-                if (!cpu.is_running) regs.set("EIP", cmd_addr + 4);
-            }
-        } catch (...) {
-            status = "JGE failed: Invalid address";
-        }
-    } else {
-        status = "JGE failed: Missing address";
-    }
+std::string CommandHandler::cmdJae(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    return jump(cmd, "JAE", Cond::AE);
+}
 
-    if (!cpu.is_running) cpu.history.push_back({cmd_addr, cmd});
-    return status;
+std::string CommandHandler::cmdJbe(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    return jump(cmd, "JBE", Cond::BE);
 }
 
-std::string CommandHandler::cmdJle(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, reg1;
-    ss >> op >> reg1;
-    std::string addr_upper = reg1;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
+// Shared body of the conditional jumps: jumps to the hex target if cond holds
+std::string CommandHandler::jump(const std::string& cmd, const char* name, Cond cond) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string reg1(words[1]);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
+    bool jumped = false;
 
     if (!reg1.empty()) {
-        try {
-            uint32_t target_addr = std::stoul(addr_upper, nullptr, 16);
-            bool zf = regs.get("FLAGS") & CPU::ZF;
-            bool sf = regs.get("FLAGS") & CPU::SF;
-            bool of = regs.get("FLAGS") & CPU::OF;
-            if (zf || (sf != of)) {
+        uint32_t target_addr;
+        ParseError error;
+        if (OperandParser::parseNumber(words[1], target_addr, error)) {
+            if (regs.test(cond)) {
                 regs.set("EIP", target_addr);
-                status = "JLE jumped to " + reg1;
+                jumped = true;
+                status = std::string(name) + " jumped to " + reg1;
             } else {
-                status = "JLE no jump";
-                if (!cpu.is_running) regs.set("EIP", cmd_addr + 4);
+                status = std::string(name) + " no jump";
             }
-        } catch (...) {
-            status = "JLE failed: Invalid address";
+        } else {
+            return std::string(name) + " failed: Invalid address" + where(cmd, words[1], error);
         }
     } else {
-        status = "JLE failed: Missing address";
+        return std::string(name) + " failed: Missing address";
     }
 
-    if (!cpu.is_running) cpu.history.push_back({cmd_addr, cmd});
+    if (!cpu.is_running) {
+        uint32_t next_addr = cpu.record(cmd);
+        if (!jumped) regs.set("EIP", next_addr);
+    }
     return status;
 }
 
 std::string CommandHandler::cmdRun(const std::string& cmd, uint32_t* memory_start_addr) {
-    uint32_t cmd_addr = regs.get("EIP");
-    std::string status;
+    if (cpu.is_running) return "RUN ignored: Already running";  // A RUN line inside the program
 
-    if (!cpu.history.empty()) {
-        cpu.is_running = true;
-        regs.set("EIP", CPU::PROGRAM_BASE);
-        uint32_t program_end = CPU::PROGRAM_BASE + (cpu.history.size() * 4);
-        while (regs.get("EIP") >= CPU::PROGRAM_BASE && regs.get("EIP") < program_end) {
-            size_t index = (regs.get("EIP") - CPU::PROGRAM_BASE) / 4;
-            if (index >= cpu.history.size()) break;
-            std::string current_cmd = cpu.history[index].second;
-            status = executeCommand(current_cmd, memory_start_addr);
-            if (status == "QUIT") {
-                cpu.is_running = false;
-                return status;
+    std::string status;
+    if (cpu.startRun()) {
+        // Unthrottled runs stay inside the interpreter until a line needs the text handlers;
+        // paced runs come back after every instruction to sleep, and watched runs after
+        // every slice to publish their state and take PAUSE/STEP/STOP
+        RunControl* control = cpu.run_control;
+        uint64_t slice = cpu.run_rate ? 1 : UINT64_MAX;
+        std::chrono::microseconds limit = control && !cpu.run_rate ? RunControl::SLICE : std::chrono::microseconds(0);
+        uint32_t window = memory_start_addr ? *memory_start_addr : 0;
+        CPU::RunExit exit = CPU::RunExit::Running;
+        bool stopped = false;
+        while (true) {
+            uint64_t budget = slice;
+            bool stepping = false;
+            if (control && control->attention()) {
+                control->publish(regs, mem, window, cpu.instructionCount(), true);
+                RunControl::Action action = control->proceed();
+                if (action == RunControl::Action::Stop) {
+                    stopped = true;
+                    break;
+                }
+                if (action == RunControl::Action::Step) {
+                    budget = 1;
+                    stepping = true;
+                }
+            }
+            exit = cpu.step(budget, limit, memory_start_addr);
+            if (exit == CPU::RunExit::Quit) {
+                cpu.stopRun();
+                return "QUIT";
             }
-            std::string op_check;
-            std::stringstream ss_check(current_cmd);
-            ss_check >> op_check;
-            std::transform(op_check.begin(), op_check.end(), op_check.begin(), ::toupper);
-            if (op_check != "JE" && op_check != "JZ" && op_check != "JNE" && op_check != "JNZ" &&
-                op_check != "JG" && op_check != "JL" && op_check != "JGE" && op_check != "JLE") {
-                regs.set("EIP", regs.get("EIP") + 4);
+            if (memory_start_addr) window = *memory_start_addr;  // A MEMVIEW line may have moved it
+            if (control) control->publish(regs, mem, window, cpu.instructionCount(), stepping);
+            if (exit != CPU::RunExit::Running) break;
+            if (cpu.run_rate && !stepping) {  // Pace execution so it can be watched
+                if (control) control->pace(std::chrono::microseconds(1000000 / cpu.run_rate));
+                else usleep(1000000 / cpu.run_rate);
             }
-            usleep(1000000); // 1s delay
         }
-        cpu.is_running = false;
-        status = "RUN completed";
+        cpu.stopRun();
+        if (stopped) {
+            status = "RUN stopped";
+        } else if (exit == CPU::RunExit::Fault) {
+            char debug_str[64];
+            snprintf(debug_str, sizeof(debug_str), "RUN failed: Invalid instruction at %08X", regs.get(Reg::EIP));
+            status = debug_str;
+        } else {
+            status = "RUN completed";
+        }
+        if (cpu.jitMismatches()) {
+            status += " (JIT check: " + std::to_string(cpu.jitMismatches()) + " mismatches)";
+        }
     } else {
-        status = "RUN failed: No history";
+        status = "RUN failed: No program";
     }
 
-    if (!cpu.history.empty()) {
-        cpu.history.push_back({cmd_addr, cmd});
-    }
+    cpu.logCommand(cmd);  // Not part of the program; EIP stays where it stopped
     return status;
 }
 
+// PAUSE, STEP and STOP act on a RUN watched from the UI, which handles them itself (see Emulator)
+// Reaching here means there is no such RUN: batch mode, or a line inside the program
+std::string CommandHandler::cmdControl(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    std::string name(firstWord(cmd));
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    if (cpu.is_running) return name + " ignored: Inside a RUN";
+    return name + " failed: No RUN in progress";
+}
+
 std::string CommandHandler::cmdClear(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, mode;
-    ss >> op >> mode;
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string mode(words[1]);
     if (mode.empty()) mode = "ALL";
     std::transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
 
     if (mode == "ALL" || mode == "REGS") {
-        for (auto& reg : regs.getAll()) {
-            if (reg.first == "ESP" && mode != "REGS") regs.set(reg.first, mem.STACK_TOP);
-            else if (reg.first == "SP" && mode != "REGS") regs.set(reg.first, mem.STACK_TOP & 0xFFFF);
-            else regs.set(reg.first, 0);
-        }
+        regs.clear();
+        if (mode != "REGS") regs.set(Reg::ESP, mem.STACK_TOP);
         if (mode == "ALL") regs.set("EIP", CPU::PROGRAM_BASE);
     }
     if (mode == "ALL" || mode == "STACK") {
         mem.clear();
         regs.set("ESP", mem.STACK_TOP);
         regs.set("SP", mem.STACK_TOP & 0xFFFF);
+        if (mode == "STACK") cpu.reassemble();  // The program lives in memory too
     }
     if (mode == "ALL" || mode == "HISTORY") {
         cpu.clearHistory();
     }
     status = "CLEAR " + mode + " executed";
 
-    if (!cpu.is_running && mode != "ALL") {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running && mode != "ALL") regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdMemset(const std::string& cmd, uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, addr_str;
-    ss >> op >> addr_str;
-    std::string addr_upper = addr_str;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string addr_str(words[1]);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
 
-    try {
-        uint32_t addr = std::stoul(addr_upper, nullptr, 16);
+    uint32_t addr;
+    ParseError error;
+    if (OperandParser::parseNumber(words[1], addr, error)) {
         if (memory_start_addr) *memory_start_addr = addr;
-        auto mem_map = mem.getAllBytes();
+        uint8_t bytes[6];
+        mem.readBytes(addr, bytes, sizeof(bytes));
         char debug_str[128];
         snprintf(debug_str, sizeof(debug_str), "MEMSET: Set to %08X: [%02x %02x %02x %02x %02x %02x]",
-                 addr,
-                 mem_map.count(addr) ? mem_map.at(addr) : 0,
-                 mem_map.count(addr + 1) ? mem_map.at(addr + 1) : 0,
-                 mem_map.count(addr + 2) ? mem_map.at(addr + 2) : 0,
-                 mem_map.count(addr + 3) ? mem_map.at(addr + 3) : 0,
-                 mem_map.count(addr + 4) ? mem_map.at(addr + 4) : 0,
-                 mem_map.count(addr + 5) ? mem_map.at(addr + 5) : 0);
+                 addr, bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5]);
         status = debug_str;
-    } catch (...) {
-        status = "MEMSET failed: Invalid address";
+    } else {
+        status = "MEMSET failed: Invalid address" + where(cmd, words[1], error);
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdSettext(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, addr_str;
-    ss >> op >> addr_str;
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string addr_str(words[1]);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
 
     if (!addr_str.empty() && cmd.find('"') != std::string::npos) {
-        try {
-            std::string addr_upper = addr_str;
-            std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
-            uint32_t addr = std::stoul(addr_upper, nullptr, 16);
+        uint32_t addr;
+        ParseError error;
+        if (OperandParser::parseNumber(words[1], addr, error)) {
             size_t quote_start = cmd.find('"');
             size_t quote_end = cmd.find('"', quote_start + 1);
             if (quote_start != std::string::npos && quote_end != std::string::npos && quote_end > quote_start + 1) {
@@ -908,33 +540,27 @@ std::string CommandHandler::cmdSettext(const std::string& cmd, [[maybe_unused]]
             } else {
                 status = "SETTEXT failed: Invalid text format";
             }
-        } catch (...) {
-            status = "SETTEXT failed: Invalid address";
+        } else {
+            status = "SETTEXT failed: Invalid address" + where(cmd, words[1], error);
         }
     } else {
         status = "SETTEXT failed: Missing address or text";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
 std::string CommandHandler::cmdMemview(const std::string& cmd, uint32_t* memory_start_addr) {
-    std::stringstream ss(cmd);
-    std::string op, addr_str;
-    ss >> op >> addr_str;
-    std::string addr_upper = addr_str;
-    std::transform(addr_upper.begin(), addr_upper.end(), addr_upper.begin(), ::toupper);
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string addr_str(words[1]);
 
-    uint32_t cmd_addr = regs.get("EIP");
     std::string status;
 
     if (!addr_str.empty()) {
-        try {
-            uint32_t addr = std::stoul(addr_upper, nullptr, 16);
+        uint32_t addr;
+        ParseError error;
+        if (OperandParser::parseNumber(words[1], addr, error)) {
             char debug_str[128];
             snprintf(debug_str, sizeof(debug_str),
                      "MEMVIEW: View set to %08X: [%02x %02x %02x %02x %02x %02x]",
@@ -943,70 +569,198 @@ std::string CommandHandler::cmdMemview(const std::string& cmd, uint32_t* memory_
                      mem.read(addr + 3, true), mem.read(addr + 4, true), mem.read(addr + 5, true));
             if (memory_start_addr) *memory_start_addr = addr;
             status = debug_str;
-        } catch (...) {
-            status = "MEMVIEW failed: Invalid address";
+        } else {
+            status = "MEMVIEW failed: Invalid address" + where(cmd, words[1], error);
         }
     } else {
         status = "MEMVIEW failed: Missing address";
     }
 
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return status;
 }
 
-std::string CommandHandler::cmdHelp(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    uint32_t cmd_addr = regs.get("EIP");
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
+std::string CommandHandler::cmdCheckpoint(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string name(words[1]);
+    if (name.empty()) name = "DEFAULT";
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
+    // Taken after logging so RESTORE lands just past this command
+    cpu.checkpoint(name);
+    return "CHECKPOINT " + name + " saved";
+}
+
+std::string CommandHandler::cmdRestore(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string name(words[1]);
+    if (name.empty()) name = "DEFAULT";
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+
+    if (cpu.is_running) return "RESTORE failed: Not allowed during RUN";
+    if (!cpu.restore(name)) return "RESTORE failed: No checkpoint " + name;
+    return "RESTORE " + name + " done";
+}
+
+std::string CommandHandler::cmdRate(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string rate_str(words[1]);
+
+    if (rate_str.empty()) return "RATE: " + std::to_string(cpu.run_rate) + " instructions/second";
+    uint32_t rate;
+    const char* end = rate_str.data() + rate_str.size();
+    auto [ptr, ec] = std::from_chars(rate_str.data(), end, rate);  // Decimal, unlike addresses and values
+    if (ec != std::errc() || ptr != end) return "RATE failed: Invalid rate";
+    cpu.run_rate = rate;
+    if (cpu.run_rate == 0) return "RATE: RUN unthrottled";
+    return "RATE: RUN at " + std::to_string(cpu.run_rate) + " instructions/second";
+}
+
+std::string CommandHandler::cmdJit(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string mode_str(words[1]);
+
+    if (mode_str.empty()) return std::string("JIT: ") + Jit::modeName(cpu.jitMode());
+    JitMode mode;
+    if (!Jit::parseMode(mode_str, mode)) return "JIT failed: Expected ON, OFF or CHECK";
+    if (mode != JitMode::Off && !Jit::available()) return "JIT failed: Not supported on this host";
+    cpu.setJitMode(mode);
+    return std::string("JIT: ") + Jit::modeName(mode);
+}
+
+std::string CommandHandler::cmdOpt(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string mode_str(words[1]);
+
+    if (mode_str.empty()) return std::string("OPT: ") + Optimizer::modeName(cpu.optMode());
+    OptMode mode;
+    if (!Optimizer::parseMode(mode_str, mode)) return "OPT failed: Expected ON, OFF or DUMP";
+    cpu.setOptMode(mode);
+    return std::string("OPT: ") + Optimizer::modeName(mode);
+}
+
+// PROFILE ON/OFF counts every RUN from then on; REPORT and FOLDED write out the last one's counts
+std::string CommandHandler::cmdProfile(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string mode(words[1]), path(words[2]), top_str(words[3]);
+    std::transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+
+    if (mode.empty()) return cpu.profiling() ? "PROFILE: ON" : "PROFILE: OFF";
+    if (cpu.is_running) return "PROFILE failed: Not allowed during RUN";
+    if (mode == "ON" || mode == "OFF") {
+        cpu.setProfiling(mode == "ON");
+        return "PROFILE: " + mode;
+    }
+    if ((mode != "REPORT" && mode != "FOLDED") || path.empty()) {
+        return "PROFILE failed: Expected ON, OFF, REPORT file [n] or FOLDED file";
+    }
+    size_t top = Profiler::DEFAULT_TOP;
+    if (!top_str.empty()) {
+        const char* end = top_str.data() + top_str.size();
+        auto [ptr, ec] = std::from_chars(top_str.data(), end, top);  // Decimal, like RATE
+        if (ec != std::errc() || ptr != end || top == 0) return "PROFILE failed: Invalid count";
+    }
+    std::ofstream out(path);
+    out << (mode == "REPORT" ? cpu.profileReport(top) : cpu.profileFolded());
+    if (!out) return "PROFILE failed: cannot write " + path;
+    return mode == "REPORT" ? "PROFILE: Report written to " + path : "PROFILE: Folded stacks written to " + path;
+}
+
+std::string CommandHandler::cmdSave(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    std::string path = argumentText(cmd);
+    if (path.empty()) return "SAVE failed: Missing file name";
+    if (cpu.is_running) return "SAVE failed: Not allowed during RUN";
+    if (cpu.isa == Isa::X86) return "SAVE failed: Not supported for a loaded binary";
+
+    std::string error;
+    if (!ImageFile::save(path, regs, mem, cpu.program, error)) return "SAVE failed: " + error;
+    return "SAVE: Machine image written to " + path;
+}
+
+std::string CommandHandler::cmdLoad(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    std::string path = argumentText(cmd);
+    if (path.empty()) return "LOAD failed: Missing file name";
+    if (cpu.is_running) return "LOAD failed: Not allowed during RUN";
+
+    std::string error;
+    if (!ImageFile::isImage(path)) {  // Anything else is a source file
+        Assembler::Output source;
+        if (!Assembler::assembleFile(path, CPU::PROGRAM_BASE, source, error)) return "LOAD failed: " + error;
+        cpu.sourceLoaded(source);
+        return "LOAD: " + std::to_string(cpu.program.size()) + " lines assembled from " + path;
+    }
+    if (!ImageFile::load(path, regs, mem, cpu.program, error)) return "LOAD failed: " + error;
+    cpu.programReplaced();
+    return "LOAD: Machine image read from " + path;
+}
+
+// Replaces the machine with an IA-32 binary; RUN then executes it from its entry point
+std::string CommandHandler::cmdLoadbin(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    OperandParser::Words words = OperandParser::split(cmd);
+    std::string path(words[1]), base_str(words[2]);
+    if (path.empty()) return "LOADBIN failed: Missing file name";
+    if (cpu.is_running) return "LOADBIN failed: Not allowed during RUN";
+
+    uint32_t base = CPU::PROGRAM_BASE;
+    if (!base_str.empty()) {
+        ParseError error;
+        if (!OperandParser::parseNumber(words[2], base, error)) {
+            return "LOADBIN failed: Invalid address" + where(cmd, words[2], error);
+        }
     }
-    return "Commands: MOV Rn Rm/val/[Rm+off] or [Rm+off]/[addr] Rn/val, MOVB R8 [Rm+off]/[addr] or [Rm+off]/[addr] val, ADD/XOR/SUB/CMP Rn Rm/val or [Rm+off]/[addr] Rn, PUSH Rn, POP Rn, JE/JZ addr, JNE/JNZ addr, JG addr, JL addr, JGE addr, JLE addr, RUN, CLEAR [ALL/REGS/STACK/HISTORY], MEMSET addr, SETTEXT addr \"text\", MEMVIEW addr, QUIT";
+
+    BinaryLoader::Image image;
+    std::string error;
+    if (!BinaryLoader::load(path, base, mem, image, error)) return "LOADBIN failed: " + error;
+    regs.clear();
+    regs.set(Reg::ESP, mem.STACK_TOP);
+    regs.set(Reg::EIP, image.entry);
+    cpu.binaryLoaded(image);
+
+    char debug_str[64];
+    snprintf(debug_str, sizeof(debug_str), "LOADBIN: %08X-%08X, entry %08X", image.start, image.end, image.entry);
+    return debug_str;
+}
+
+std::string CommandHandler::cmdHelp(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
+    return "Commands: MOV Rn Rm/val/[mem] or [mem] Rn/val, MOVB R8 [mem] or [mem] val, ADD/XOR/SUB/CMP Rn Rm/val/[mem] or [mem] Rn/val ([mem] = [base+index*scale+disp]; values hex, #dec or 'c'), PUSH Rn, POP Rn, JE/JZ addr, JNE/JNZ addr, JG addr, JL addr, JGE addr, JLE addr, JA/JB/JAE/JBE addr (unsigned), RUN, PAUSE/STEP/STOP (while a RUN is shown; STEP starts one paused), CLEAR [ALL/REGS/STACK/HISTORY], MEMSET addr, SETTEXT addr \"text\", MEMVIEW addr, RATE [n/s, 0=max], JIT [ON/OFF/CHECK], OPT [ON/OFF/DUMP], PROFILE [ON/OFF], PROFILE REPORT file [n], PROFILE FOLDED file, CHECKPOINT [name], RESTORE [name], SAVE file, LOAD file (an image, or source with labels and .data/.org/.byte/.dword/.ascii), LOADBIN file [base] (flat or ELF32 i386 binary), QUIT";
 }
 
 std::string CommandHandler::cmdQuit(const std::string& cmd, [[maybe_unused]] uint32_t* memory_start_addr) {
-    uint32_t cmd_addr = regs.get("EIP");
-    if (!cpu.is_running) {
-        cpu.history.push_back({cmd_addr, cmd});
-        regs.set("EIP", cmd_addr + 4);
-    }
+    if (!cpu.is_running) regs.set("EIP", cpu.record(cmd));
     return "QUIT";
 }
 
-bool CommandHandler::parseMemoryAddress(const std::string& arg, std::string& reg_out, int32_t& offset_out) {
-    if (arg.size() < 3 || arg[0] != '[' || arg.back() != ']') return false;
-    std::string inner = arg.substr(1, arg.size() - 2);
-    size_t plus_pos = inner.find('+');
-    size_t minus_pos = inner.find('-');
-    std::string reg_str, offset_str;
-
-    if (plus_pos != std::string::npos) {
-        reg_str = inner.substr(0, plus_pos);
-        offset_str = inner.substr(plus_pos + 1);
-        offset_out = std::stoi(offset_str, nullptr, 16);
-    } else if (minus_pos != std::string::npos) {
-        reg_str = inner.substr(0, minus_pos);
-        offset_str = inner.substr(minus_pos + 1);
-        offset_out = -std::stoi(offset_str, nullptr, 16);
-    } else {
-        reg_str = inner;
-        offset_out = 0;
-    }
+// Parses a memory operand (see OperandParser) and computes its address from the current registers
+bool CommandHandler::memoryAddress(std::string_view arg, uint32_t& addr, ParseError& error) const {
+    Operand op;
+    if (!OperandParser::parseMemory(arg, op, error)) return false;
+    addr = address(op);
+    return true;
+}
 
-    std::transform(reg_str.begin(), reg_str.end(), reg_str.begin(), ::toupper);
-    if (regs.getAll().count(reg_str)) {
-        reg_out = reg_str;
-        return true;
-    } else {
-        try {
-            uint32_t direct_addr = std::stoul(reg_str, nullptr, 16);
-            reg_out = "";
-            offset_out = direct_addr;
-            return true;
-        } catch (...) {
-            return false;
-        }
-    }
+// Address of a parsed memory operand from the current registers
+uint32_t CommandHandler::address(const Operand& op) const {
+    uint32_t addr = op.value;
+    if (op.reg != Reg::NONE) addr += regs.get(op.reg);
+    if (op.index != Reg::NONE) addr += regs.get(op.index) * op.scale;
+    return addr;
+}
+
+// " (reason at column n)" for a parse error in arg, a word of cmd
+std::string CommandHandler::where(const std::string& cmd, std::string_view arg, const ParseError& error) {
+    size_t column = arg.data() ? static_cast<size_t>(arg.data() - cmd.data()) + error.pos : cmd.size();
+    return std::string(" (") + error.message + " at column " + std::to_string(column + 1) + ")";
+}
+
+// Returns everything after the command word, trimmed (e.g. a file name that may contain spaces)
+std::string CommandHandler::argumentText(const std::string& cmd) {
+    size_t start = cmd.find_first_not_of(" \t");
+    start = cmd.find_first_of(" \t", start);
+    start = cmd.find_first_not_of(" \t", start);
+    if (start == std::string::npos) return "";
+    size_t end = cmd.find_last_not_of(" \t");
+    return cmd.substr(start, end - start + 1);
 }
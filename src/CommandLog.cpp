@@ -0,0 +1,29 @@
+#include "CommandLog.hpp"
+#include <cstring>
+
+CommandLog::CommandLog() : next(0), total(0) {}
+
+void CommandLog::push(uint32_t addr, std::string_view line) {
+    Entry entry;
+    entry.addr = addr;
+    entry.length = static_cast<uint8_t>(line.size() < TEXT_BYTES ? line.size() : TEXT_BYTES);
+    std::memcpy(entry.text, line.data(), entry.length);
+    if (entries.size() < CAPACITY) {
+        entries.push_back(entry);
+    } else {
+        entries[next] = entry;
+        next = (next + 1) % CAPACITY;
+    }
+    total++;
+}
+
+void CommandLog::clear() {
+    entries.clear();
+    next = 0;
+}
+
+const CommandLog::Entry& CommandLog::recent(size_t age) const {
+    // Before wrapping the newest is at the back; after, it is just before next
+    size_t newest = entries.size() < CAPACITY ? entries.size() - 1 : (next + CAPACITY - 1) % CAPACITY;
+    return entries[(newest + CAPACITY - age) % CAPACITY];
+}
@@ -0,0 +1,111 @@
+#include "Decoder.hpp"
+#include "OperandParser.hpp"
+
+// Parses one program line into an Instruction
+// Only operand forms the text handlers accept are decoded; anything else
+// stays Text so it fails (or runs) exactly as it does interactively
+// Works on views into line, so decoding never allocates
+Instruction Decoder::decode(std::string_view line) {
+    OperandParser::Words words = OperandParser::split(line);
+    std::string_view op = words[0], arg1 = words[1], arg2 = words[2];
+
+    Instruction insn;
+    Instruction text;  // Returned whenever the line has no decoded form
+
+    Mnemonic mnemonic = lookupMnemonic(op);
+    switch (mnemonic) {
+        case Mnemonic::MOV:
+            insn.op = Opcode::Mov;
+            if (parseMemory(arg1, insn.dst)) {
+                if (!parseRegister(arg2, insn.src) && !parseImmediate(arg2, insn.src)) return text;
+            } else if (parseRegister(arg1, insn.dst)) {
+                if (!parseRegister(arg2, insn.src) && !parseMemory(arg2, insn.src) && !parseImmediate(arg2, insn.src)) return text;
+            } else {
+                return text;
+            }
+            break;
+        case Mnemonic::MOVB:
+            insn.op = Opcode::Movb;
+            if (parseMemory(arg1, insn.dst)) {
+                if (!parseImmediate(arg2, insn.src) || insn.src.value > 0xFF) return text;
+            } else if (parseRegister(arg1, insn.dst)) {
+                if (insn.dst.reg < Reg::AL || insn.dst.reg > Reg::BH) return text;  // Byte registers only
+                if (!parseMemory(arg2, insn.src)) return text;
+            } else {
+                return text;
+            }
+            break;
+        case Mnemonic::ADD:
+        case Mnemonic::XOR:
+        case Mnemonic::SUB:
+        case Mnemonic::CMP:
+            insn.op = mnemonic == Mnemonic::ADD ? Opcode::Add : mnemonic == Mnemonic::XOR ? Opcode::Xor
+                    : mnemonic == Mnemonic::SUB ? Opcode::Sub : Opcode::Cmp;
+            // Every form but [m] [m]: r r, r imm, r [m], [m] r, [m] imm
+            if (parseMemory(arg1, insn.dst)) {
+                if (!parseRegister(arg2, insn.src) && !parseImmediate(arg2, insn.src)) return text;
+            } else if (parseRegister(arg1, insn.dst)) {
+                if (!parseRegister(arg2, insn.src) && !parseMemory(arg2, insn.src) && !parseImmediate(arg2, insn.src)) return text;
+            } else {
+                return text;
+            }
+            break;
+        case Mnemonic::PUSH:
+        case Mnemonic::POP:
+            insn.op = mnemonic == Mnemonic::PUSH ? Opcode::Push : Opcode::Pop;
+            if (!parseRegister(arg1, insn.dst)) return text;
+            break;
+        case Mnemonic::JE:
+        case Mnemonic::JZ:
+        case Mnemonic::JNE:
+        case Mnemonic::JNZ:
+        case Mnemonic::JG:
+        case Mnemonic::JL:
+        case Mnemonic::JGE:
+        case Mnemonic::JLE:
+        case Mnemonic::JA:
+        case Mnemonic::JB:
+        case Mnemonic::JAE:
+        case Mnemonic::JBE:
+            insn.op = jumpOpcode(mnemonic);
+            if (!parseImmediate(arg1, insn.dst)) return text;
+            break;
+        default:
+            return text;
+    }
+    insn.width = bytecodeWidth(insn.op, insn.dst);
+    return insn;
+}
+
+// Maps a conditional jump mnemonic (including the JZ/JNZ aliases) to its opcode
+Opcode Decoder::jumpOpcode(Mnemonic mnemonic) {
+    switch (mnemonic) {
+        case Mnemonic::JE: case Mnemonic::JZ: return Opcode::Je;
+        case Mnemonic::JNE: case Mnemonic::JNZ: return Opcode::Jne;
+        case Mnemonic::JG: return Opcode::Jg;
+        case Mnemonic::JL: return Opcode::Jl;
+        case Mnemonic::JGE: return Opcode::Jge;
+        case Mnemonic::JLE: return Opcode::Jle;
+        case Mnemonic::JA: return Opcode::Ja;
+        case Mnemonic::JB: return Opcode::Jb;
+        case Mnemonic::JAE: return Opcode::Jae;
+        default: return Opcode::Jbe;
+    }
+}
+
+bool Decoder::parseMemory(std::string_view arg, Operand& out) {
+    ParseError error;
+    return OperandParser::parseMemory(arg, out, error);
+}
+
+bool Decoder::parseImmediate(std::string_view arg, Operand& out) {
+    ParseError error;
+    if (!OperandParser::parseNumber(arg, out.value, error)) return false;
+    out.kind = OperandKind::Imm;
+    return true;
+}
+
+bool Decoder::parseRegister(std::string_view arg, Operand& out) {
+    ParseError error;
+    return OperandParser::parseRegister(arg, out, error);
+}
@@ -1,51 +1,202 @@
 #include "Emulator.hpp"
-#include <unistd.h>      // For usleep() to introduce delays
+#include "Mnemonic.hpp"
+#include <atomic>        // For the worker's done flag in watchRun
+#include <thread>        // For running RUN beside the UI
 #include <sstream>       // For string stream processing
 #include <algorithm>     // For std::transform to convert strings to uppercase
+#include <fstream>       // For reading batch program files
+#include <cstdio>        // For printf in batch mode
 
 // Constructor for Emulator class
 // Initializes the CPU with registers (regs) and memory (mem), sets default memory start address
-Emulator::Emulator() : cpu(regs, mem), memory_start_addr(0xFFFFF000) {}
+Emulator::Emulator()
+    : cpu(regs, mem), memory_start_addr(0xFFFFF000), startup_status("Ready (Enter to submit)"), profile_top(0) {}
+
+// Restores a machine image saved with SAVE before the session starts
+// The result is shown in the status window once the UI comes up
+void Emulator::loadImage(const std::string& path) {
+    startup_status = cpu.execute("LOAD " + path, &memory_start_addr) + " (Enter to submit)";
+}
+
+// Assembles a source file into the program, replacing the machine state
+// Returns the LOAD status
+std::string Emulator::loadProgram(const std::string& path) {
+    std::string status = cpu.execute("LOAD " + path, &memory_start_addr);
+    startup_status = status + " (Enter to submit)";
+    return status;
+}
+
+// Loads an IA-32 binary for RUN; flat binaries are placed at base
+// Returns the LOADBIN status
+std::string Emulator::loadBinary(const std::string& path, uint32_t base) {
+    char base_str[16];
+    snprintf(base_str, sizeof(base_str), " %X", base);
+    std::string status = cpu.execute("LOADBIN " + path + base_str, &memory_start_addr);
+    startup_status = status + " (Enter to submit)";
+    return status;
+}
+
+// Sets how many instructions per second RUN executes (0 = unthrottled)
+void Emulator::setRunRate(uint32_t rate) {
+    cpu.run_rate = rate;
+}
+
+void Emulator::setJitMode(JitMode mode) {
+    cpu.setJitMode(mode);
+}
+
+void Emulator::setOptMode(OptMode mode) {
+    cpu.setOptMode(mode);
+}
+
+// Profiles every RUN; a batch run then prints the top rows and writes the folded stacks, if asked
+void Emulator::setProfile(size_t top, const std::string& path) {
+    cpu.setProfiling(true);
+    profile_top = top;
+    folded_path = path;
+}
 
 // Main execution loop for the emulator
+// Waits for a line, runs it and draws one frame; panes whose contents did not change are left alone
+// RUN and STEP go to watchRun so the screen stays live while the program executes
 void Emulator::run() {
-    // Initial UI update: display registers, stack, memory, and status
-    screen.updateRegisters(regs.getAll(), "");  // Show all register values
-    screen.updateStack(mem, regs.get("ESP"));  // Update stack view using ESP (stack pointer)
-    screen.updateMemoryAndHistory(mem.getAllBytes(), memory_start_addr, cpu.getHistory());  // Show memory and CPU history
-    screen.updateStatus("Ready (Enter to submit)");  // Indicate emulator is ready for input
+    screen.reset(new Screen());  // Bring up ncurses only for interactive sessions
+    cpu.run_control = &run_control;
+    render(startup_status);
 
-    // Infinite loop to process emulator commands
+    std::string input;
     while (true) {
+        screen->promptInput();
+        input.clear();
+        while (!screen->readInput(input, -1)) {  // Blocks until Enter; a PgUp/PgDn redraws only History
+            screen->updateHistory(cpu.log());
+            screen->present();
+        }
+        if (input.empty()) continue;
+        Mnemonic op = lookupMnemonic(firstWord(input));
+        bool quit = false;
+        std::string status;
+        if ((op == Mnemonic::RUN || op == Mnemonic::STEP) && !cpu.is_running) {
+            status = watchRun(op == Mnemonic::STEP, quit);
+        } else {
+            status = cpu.execute(input, &memory_start_addr);
+            quit = status == "QUIT";
+        }
+        if (quit) break;
+        render(status);
+    }
+}
+
+// Executes RUN on a worker thread and keeps the screen and input line live until it ends
+// Only the worker touches the machine meanwhile; the UI draws what it publishes through
+// run_control and takes PAUSE, STEP, RUN (resume), STOP and QUIT. History is redrawn at the end.
+// A STEP that starts the RUN leaves it paused on its first instruction.
+std::string Emulator::watchRun(bool paused, bool& quit) {
+    run_control.start(paused, screen->memoryRows());
+    std::atomic<bool> done(false);
+    std::string status;
+    std::thread worker([&] {
+        status = cpu.execute("RUN", &memory_start_addr);
+        done.store(true, std::memory_order_release);
+    });
 
-        std::string input = screen.getInput();
-        if (!input.empty()) {
-            std::string status = cpu.execute(input, &memory_start_addr);
-
-            auto mem_map = mem.getAllBytes();
-            std::string mem_check = " | MemMap at 100 = " +
-                                    std::to_string(mem_map.count(0x100) ? mem_map.at(0x100) : 0);
-            std::string debug = " | DEBUG: memory_start_addr = " + std::to_string(memory_start_addr) +
-                                " Mem at 100 = " + std::to_string(mem.read(0x100, true));
-
-            screen.updateStatus(status + mem_check + debug);
-            screen.updateRegisters(regs.getAll(), "");
-            screen.updateStack(mem, regs.get("ESP"));
-            screen.updateMemoryAndHistory(mem.getAllBytes(), memory_start_addr, cpu.getHistory());
-
-            // Update UI with status, memory checks, and debug info
-            screen.updateStatus(status + mem_check_execute + debug + mem_check);
-            screen.updateRegisters(regs.getAll(), "");  // Refresh register display
-            screen.updateStack(mem, regs.get("ESP"));  // Refresh stack display
-            screen.updateMemoryAndHistory(mem.getAllBytes(), memory_start_addr, cpu.getHistory());  // Refresh memory and history
-
-            // Check for QUIT command to exit the loop
-            if (status == "QUIT") {
-                break;  // Exit the emulator loop
-            }
+    std::string line, note;
+    RunControl::Frame frame;
+    std::vector<uint8_t> memory(screen->memoryRows() * 16);  // Rows past MAX_MEMORY_ROWS stay blank
+    screen->promptInput();
+    while (!done.load(std::memory_order_acquire)) {
+        if (screen->readInput(line, 33)) {  // About 30 frames a second
+            Mnemonic op = lookupMnemonic(firstWord(line));
+            if (op == Mnemonic::PAUSE) run_control.pause();
+            else if (op == Mnemonic::STEP) run_control.step();
+            else if (op == Mnemonic::RUN) run_control.resume();
+            else if (op == Mnemonic::STOP || op == Mnemonic::QUIT) run_control.stop();
+            if (op == Mnemonic::QUIT) quit = true;
+            note = op == Mnemonic::PAUSE || op == Mnemonic::STEP || op == Mnemonic::RUN || op == Mnemonic::STOP ||
+                   op == Mnemonic::QUIT || line.empty() ? "" : "Busy: " + line + " ignored; ";
+            line.clear();
+            screen->promptInput();
         }
+        if (!run_control.sample(frame)) continue;
+
+        char eip[16];
+        snprintf(eip, sizeof(eip), "%08X", frame.regs.get(Reg::EIP));
+        screen->updateStatus(note + "RUN: " + std::to_string(frame.retired) + " instructions, EIP " + eip +
+                             (run_control.paused() ? " (paused: STEP, RUN or STOP)" : " (PAUSE or STOP)"));
+        screen->updateRegisters(frame.regs, "");
+        screen->updateStack(frame.regs.get(Reg::ESP), frame.stack);
+        std::copy(frame.memory, frame.memory + std::min(memory.size(), sizeof(frame.memory)), memory.begin());
+        screen->updateMemory(frame.memory_addr, memory.data());
+        screen->present();
+    }
+    worker.join();
+    return status;
+}
 
-        // Brief delay (50ms) to prevent excessive CPU usage
-        usleep(50000);
+// Stages every pane with the current machine state and writes the frame
+void Emulator::render(const std::string& status) {
+    screen->updateStatus(status);
+    screen->updateRegisters(regs, "");
+    screen->updateStack(mem, regs.get(Reg::ESP));
+    screen->updateMemoryAndHistory(mem, memory_start_addr, cpu.log());
+    screen->present();
+}
+
+// Headless execution: loads a program file, runs it at full speed and prints the final state
+// Lines are added to the program as-is (blank lines and lines starting with ';' or '#' are skipped)
+// Returns a process exit status
+int Emulator::runBatch(const std::string& program_path, const std::vector<std::pair<uint32_t, uint32_t>>& dumps) {
+    std::ifstream in;
+    if (!program_path.empty()) {  // Without a program, RUN executes what is already loaded
+        in.open(program_path);
+        if (!in) {
+            fprintf(stderr, "emulator: cannot open %s\n", program_path.c_str());
+            return 1;
+        }
+    }
+    std::string line;
+    while (in.is_open() && std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == ';' || line[start] == '#') continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        cpu.appendProgram(line.substr(start, end - start + 1));
+    }
+
+    cpu.run_rate = 0;  // No pacing without a screen to watch
+    std::string status = cpu.execute("RUN", &memory_start_addr);
+    printf("%s (%llu instructions)\n", status.c_str(), static_cast<unsigned long long>(cpu.instructionCount()));
+    printState(dumps);
+    if (profile_top) fputs(cpu.profileReport(profile_top).c_str(), stdout);
+    if (!folded_path.empty()) {
+        std::string folded_status = cpu.execute("PROFILE FOLDED " + folded_path, &memory_start_addr);
+        if (folded_status.rfind("PROFILE failed", 0) == 0) fprintf(stderr, "emulator: %s\n", folded_status.c_str());
+    }
+    return status == "RUN completed" || status == "QUIT" ? 0 : 1;
+}
+
+// Prints registers, FLAGS and the requested memory ranges to stdout
+void Emulator::printState(const std::vector<std::pair<uint32_t, uint32_t>>& dumps) const {
+    const char* rows[][4] = {{"EAX", "EBX", "ECX", "EDX"}, {"ESI", "EDI", "ESP", "EBP"}};
+    for (const auto& row : rows) {
+        printf("%s=%08X %s=%08X %s=%08X %s=%08X\n", row[0], regs.get(row[0]), row[1], regs.get(row[1]),
+               row[2], regs.get(row[2]), row[3], regs.get(row[3]));
+    }
+    uint32_t flags = regs.get("FLAGS");
+    printf("EIP=%08X FLAGS=%04X [%s%s%s%s%s%s]\n", regs.get("EIP"), flags,
+           (flags & CPU::CF) ? " CF" : "", (flags & CPU::PF) ? " PF" : "", (flags & CPU::AF) ? " AF" : "",
+           (flags & CPU::ZF) ? " ZF" : "", (flags & CPU::SF) ? " SF" : "", (flags & CPU::OF) ? " OF" : "");
+
+    for (const auto& dump : dumps) {
+        // 16 bytes per row: address, hex bytes, ASCII
+        for (uint32_t offset = 0; offset < dump.second; offset += 16) {
+            uint8_t row[16];
+            uint32_t count = dump.second - offset < 16 ? dump.second - offset : 16;
+            mem.readBytes(dump.first + offset, row, count);
+            printf("%08X:", dump.first + offset);
+            for (uint32_t i = 0; i < count; i++) printf(" %02X", row[i]);
+            printf("%*s  ", static_cast<int>(3 * (16 - count)), "");
+            for (uint32_t i = 0; i < count; i++) putchar(row[i] >= 32 && row[i] <= 126 ? row[i] : '.');
+            printf("\n");
+        }
     }
 }
@@ -0,0 +1,77 @@
+#include "Flags.hpp"
+
+// Carry: unsigned overflow of an add, borrow of a subtract
+bool LazyFlags::cf() const {
+    switch (op_) {
+        case FlagOp::Add: return result_ < a_;
+        case FlagOp::Sub: return a_ < b_;
+        case FlagOp::Logic: return false;
+        case FlagOp::Inc:
+        case FlagOp::Dec: return carry_;
+        default: return (value_ & CF) != 0;
+    }
+}
+
+// Overflow: the signed result does not fit in the operation's width
+bool LazyFlags::of() const {
+    switch (op_) {
+        case FlagOp::Add:
+        case FlagOp::Inc: return (((a_ ^ result_) & (b_ ^ result_)) >> 31) != 0;  // Operands agree, result differs
+        case FlagOp::Sub:
+        case FlagOp::Dec: return (((a_ ^ b_) & (a_ ^ result_)) >> 31) != 0;       // Operands differ, result took b's sign
+        case FlagOp::Logic: return false;
+        default: return (value_ & OF) != 0;
+    }
+}
+
+// Parity: set when the low byte of the result has an even number of 1 bits
+bool LazyFlags::pf() const {
+    if (op_ == FlagOp::None) return (value_ & PF) != 0;
+    uint32_t low = (result_ >> shift_) & 0xFF;
+    low ^= low >> 4;
+    return ((0x6996 >> (low & 0xF)) & 1) == 0;  // 0x6996 is the odd-parity table for a nibble
+}
+
+// Auxiliary carry: carry or borrow out of bit 3
+bool LazyFlags::af() const {
+    switch (op_) {
+        case FlagOp::Add:
+        case FlagOp::Sub:
+        case FlagOp::Inc:
+        case FlagOp::Dec: return (((a_ ^ b_ ^ result_) >> shift_) & 0x10) != 0;
+        case FlagOp::Logic: return false;
+        default: return (value_ & AF) != 0;
+    }
+}
+
+// Builds the full FLAGS word (for display, FLAGS reads and saving)
+uint32_t LazyFlags::value() const {
+    if (op_ == FlagOp::None) return value_;
+    uint32_t flags = 0;
+    if (cf()) flags |= CF;
+    if (pf()) flags |= PF;
+    if (af()) flags |= AF;
+    if (zf()) flags |= ZF;
+    if (sf()) flags |= SF;
+    if (of()) flags |= OF;
+    return flags;
+}
+
+// Evaluates a jump condition, touching only the flags it needs
+// After SUB/CMP the condition is a direct comparison of the operands
+bool LazyFlags::test(Cond cond) const {
+    if (op_ == FlagOp::Sub) return compareHolds(cond, a_, b_);
+    switch (cond) {
+        case Cond::E: return zf();
+        case Cond::NE: return !zf();
+        case Cond::G: return !zf() && sf() == of();
+        case Cond::L: return sf() != of();
+        case Cond::GE: return sf() == of();
+        case Cond::LE: return zf() || sf() != of();
+        case Cond::A: return !cf() && !zf();
+        case Cond::B: return cf();
+        case Cond::AE: return !cf();
+        case Cond::BE: return cf() || zf();
+    }
+    return false;
+}
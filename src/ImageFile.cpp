@@ -0,0 +1,194 @@
+#include "ImageFile.hpp"
+#include <string_view>
+#include <fstream>
+#include <memory>
+#include <cstring>
+#include <fcntl.h>     // For open
+#include <sys/mman.h>  // For mmap/munmap
+#include <sys/stat.h>  // For fstat
+#include <unistd.h>    // For close
+
+namespace {
+
+const char MAGIC[8] = {'E', 'M', 'U', 'I', 'M', 'A', 'G', 'E'};
+
+// Rounds a file offset up to the next page boundary
+uint64_t alignToPage(uint64_t offset) {
+    return (offset + Memory::PAGE_SIZE - 1) & ~static_cast<uint64_t>(Memory::PAGE_SIZE - 1);
+}
+
+bool isZeroPage(const Memory::Page& page) {
+    for (uint8_t byte : page) {
+        if (byte) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+// Writes registers, non-zero memory pages and the program to path
+bool ImageFile::save(const std::string& path, const Registers& regs, const Memory& mem,
+                     const Program& program, std::string& error) {
+    std::vector<std::pair<uint32_t, const Memory::Page*>> pages;
+    mem.forEachPage([&pages](uint32_t addr, const Memory::Page& page) {
+        if (!isZeroPage(page)) pages.push_back({addr, &page});  // Zero pages are implied
+    });
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.reg_count = static_cast<uint32_t>(Reg::COUNT);
+    header.page_count = pages.size();
+    header.program_count = program.size();
+    header.eip = regs.get("EIP");
+    header.flags = regs.get("FLAGS");
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot open " + path;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& page : pages) {
+        out.write(reinterpret_cast<const char*>(&page.first), sizeof(uint32_t));
+    }
+    for (int i = 0; i < static_cast<int>(Reg::COUNT); i++) {
+        RegisterEntry entry = {};
+        const char* name = Registers::name(static_cast<Reg>(i));
+        std::memcpy(entry.name, name, strnlen(name, sizeof(entry.name)));  // Not NUL-terminated when 8 long
+        entry.value = regs.get(static_cast<Reg>(i));
+        out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    // The program section is built in one buffer and written at once
+    std::string section;
+    for (size_t i = 0; i < program.size(); i++) {
+        size_t at = section.size();
+        section.append(2 * sizeof(uint32_t), '\0');
+        program.appendLine(i, section);
+        uint32_t addr = program.addr(i);
+        uint32_t len = section.size() - at - 2 * sizeof(uint32_t);
+        std::memcpy(&section[at], &addr, sizeof(uint32_t));
+        std::memcpy(&section[at + sizeof(uint32_t)], &len, sizeof(uint32_t));
+    }
+    out.write(section.data(), section.size());
+    // Pad so page data starts page-aligned and can be mapped in place
+    uint64_t pos = out.tellp();
+    std::vector<char> padding(alignToPage(pos) - pos, 0);
+    out.write(padding.data(), padding.size());
+    for (const auto& page : pages) {
+        out.write(reinterpret_cast<const char*>(page.second->data()), Memory::PAGE_SIZE);
+    }
+    if (!out) {
+        error = "write to " + path + " failed";
+        return false;
+    }
+    return true;
+}
+
+bool ImageFile::isImage(const std::string& path) {
+    char magic[sizeof(MAGIC)];
+    std::ifstream in(path, std::ios::binary);
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// Maps path and replaces the machine state with its contents
+// Nothing is modified unless the whole file validates
+bool ImageFile::load(const std::string& path, Registers& regs, Memory& mem,
+                     Program& program, std::string& error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        error = path + " is not an image file";
+        return false;
+    }
+    size_t size = st.st_size;
+    // Private writable mapping: guest writes to a page still owned only by the
+    // mapping land in a private copy made by the kernel, never in the file
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps its own reference to the file
+    if (base == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    // Every page installed below shares ownership of the mapping
+    std::shared_ptr<uint8_t> mapping(static_cast<uint8_t*>(base), [size](uint8_t* p) { munmap(p, size); });
+    const uint8_t* data = mapping.get();
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " is not an image file";
+        return false;
+    }
+    if (header.version != VERSION) {
+        error = "unsupported image version " + std::to_string(header.version);
+        return false;
+    }
+
+    // Validate every section against the file size before touching any state
+    uint64_t pos = sizeof(Header);
+    uint64_t index_pos = pos;
+    pos += static_cast<uint64_t>(header.page_count) * sizeof(uint32_t);
+    uint64_t regs_pos = pos;
+    pos += static_cast<uint64_t>(header.reg_count) * sizeof(RegisterEntry);
+    if (pos > size) {
+        error = path + " is truncated";
+        return false;
+    }
+    uint64_t program_pos = pos;
+    for (uint32_t i = 0; i < header.program_count; i++) {
+        uint32_t addr, len;
+        if (pos + 2 * sizeof(uint32_t) > size) {
+            error = path + " is truncated";
+            return false;
+        }
+        std::memcpy(&addr, data + pos, sizeof(uint32_t));
+        std::memcpy(&len, data + pos + sizeof(uint32_t), sizeof(uint32_t));
+        pos += 2 * sizeof(uint32_t);
+        if (pos + len > size) {
+            error = path + " is truncated";
+            return false;
+        }
+        pos += len;
+    }
+    uint64_t pages_pos = alignToPage(pos);
+    if (pages_pos + static_cast<uint64_t>(header.page_count) * Memory::PAGE_SIZE > size) {
+        error = path + " is truncated";
+        return false;
+    }
+
+    // Valid; assemble the program into buffers sized for it up front
+    Program lines;
+    lines.reserve(header.program_count, pos - program_pos - 2 * sizeof(uint32_t) * header.program_count);
+    for (uint64_t at = program_pos; at < pos;) {
+        uint32_t addr, len;
+        std::memcpy(&addr, data + at, sizeof(uint32_t));
+        std::memcpy(&len, data + at + sizeof(uint32_t), sizeof(uint32_t));
+        at += 2 * sizeof(uint32_t);
+        lines.append(addr, std::string_view(reinterpret_cast<const char*>(data + at), len));
+        at += len;
+    }
+
+    mem.clear();
+    for (uint32_t i = 0; i < header.page_count; i++) {
+        uint32_t addr;
+        std::memcpy(&addr, data + index_pos + i * sizeof(uint32_t), sizeof(uint32_t));
+        auto* page = reinterpret_cast<Memory::Page*>(mapping.get() + pages_pos + static_cast<uint64_t>(i) * Memory::PAGE_SIZE);
+        mem.mapPage(addr & ~(Memory::PAGE_SIZE - 1), std::shared_ptr<Memory::Page>(mapping, page));
+    }
+    for (uint32_t i = 0; i < header.reg_count; i++) {
+        RegisterEntry entry;
+        std::memcpy(&entry, data + regs_pos + i * sizeof(RegisterEntry), sizeof(entry));
+        std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        regs.set(name, entry.value);  // Registers this build does not know are ignored
+    }
+    regs.set("EIP", header.eip);
+    regs.set("FLAGS", header.flags);
+    program = std::move(lines);
+    return true;
+}
@@ -0,0 +1,526 @@
+#include "Interpreter.hpp"
+#include "CPU.hpp"
+#include "Bytecode.hpp"
+#include "X86Decoder.hpp"
+#include "Alu.hpp"
+#include <algorithm>  // For std::max in block()
+#include <cstdio>     // For fputs in block()
+
+// Labels as values (computed goto) let every handler jump straight to the
+// next one; other compilers fall back to a single switch
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_DISPATCH 1
+#else
+#define THREADED_DISPATCH 0
+#endif
+
+// Every ADD/XOR/SUB/CMP form the decoders produce, each with its own handler:
+// register or memory destination, register, immediate or memory source
+// (never both memory), 32-bit, 16-bit or byte. X(op, dst, src, width, flags)
+// per form, in the order of their handler numbers (see aluHandler). Only a
+// register destination is ever 16-bit (AX..DI in bytecode). ADD/XOR/SUB also
+// come without flags, for Fold::Quiet; CMP without flags does nothing and
+// becomes a NOP instead.
+#define ALU_WIDTH(X, OP, W, FLAGS)                                                                 \
+    X(OP, Reg, Reg, W, FLAGS) X(OP, Reg, Imm, W, FLAGS) X(OP, Reg, Mem, W, FLAGS)                  \
+    X(OP, Mem, Reg, W, FLAGS) X(OP, Mem, Imm, W, FLAGS)
+#define ALU_FORMS(X, OP, FLAGS) ALU_WIDTH(X, OP, Dword, FLAGS) ALU_WIDTH(X, OP, Word, FLAGS) ALU_WIDTH(X, OP, Byte, FLAGS)
+#define ALU_VARIANTS(X)                                                                            \
+    ALU_FORMS(X, Add, true) ALU_FORMS(X, Xor, true) ALU_FORMS(X, Sub, true) ALU_FORMS(X, Cmp, true) \
+    ALU_FORMS(X, Add, false) ALU_FORMS(X, Xor, false) ALU_FORMS(X, Sub, false)
+
+// CMP/SUB forms that can be fused with the Jcc after them (Fold::Branch): 32-bit,
+// and for SUB only into a register. X(op, dst, src) in handler number order.
+#define FUSED_VARIANTS(X)                                                                          \
+    X(Cmp, Reg, Reg) X(Cmp, Reg, Imm) X(Cmp, Reg, Mem) X(Cmp, Mem, Reg) X(Cmp, Mem, Imm)           \
+    X(Sub, Reg, Reg) X(Sub, Reg, Imm) X(Sub, Reg, Mem)
+
+namespace {
+
+// Handler numbers: Opcodes, then the ALU forms, the fused forms and the register clear
+constexpr size_t ALU_BASE = static_cast<size_t>(Opcode::Invalid) + 1;
+constexpr size_t ALU_FORM_COUNT = 15;
+constexpr size_t ALU_QUIET_BASE = ALU_BASE + 4 * ALU_FORM_COUNT;
+constexpr size_t FUSED_BASE = ALU_QUIET_BASE + 3 * ALU_FORM_COUNT;
+constexpr size_t CLEAR = FUSED_BASE + 8;
+constexpr size_t HANDLER_COUNT = CLEAR + 1;
+static_assert(HANDLER_COUNT <= 256, "Handler numbers must fit in Instruction::handler");
+
+// Position of an operand form within ALU_FORMS and FUSED_VARIANTS
+constexpr size_t aluForm(OperandKind dst, OperandKind src) {
+    return dst == OperandKind::Mem ? 3 + (src == OperandKind::Imm)
+         : src == OperandKind::Reg ? 0 : src == OperandKind::Imm ? 1 : 2;
+}
+
+constexpr uint8_t aluHandler(Opcode op, OperandKind dst, OperandKind src, Width width, bool flags) {
+    size_t n = static_cast<size_t>(op) - static_cast<size_t>(Opcode::Add);
+    return static_cast<uint8_t>((flags ? ALU_BASE : ALU_QUIET_BASE) + n * ALU_FORM_COUNT + static_cast<size_t>(width) * 5 +
+                                aluForm(dst, src));
+}
+
+constexpr uint8_t fusedHandler(Opcode op, OperandKind dst, OperandKind src) {
+    return static_cast<uint8_t>(FUSED_BASE + (op == Opcode::Sub ? 5 : 0) + aluForm(dst, src));
+}
+
+// Chosen once per instruction, when its block is built, so handlers never test operand kinds
+uint8_t handlerFor(const Instruction& insn) {
+    switch (insn.fold) {
+        case Fold::Branch: return fusedHandler(insn.op, insn.dst.kind, insn.src.kind);
+        case Fold::Clear: return static_cast<uint8_t>(CLEAR);
+        default: break;
+    }
+    if (insn.op >= Opcode::Add && insn.op <= Opcode::Cmp) {
+        return aluHandler(insn.op, insn.dst.kind, insn.src.kind, insn.width, insn.fold != Fold::Quiet);
+    }
+    return static_cast<uint8_t>(insn.op);
+}
+
+}  // namespace
+
+Interpreter::Interpreter(Registers& r, Memory& m)
+    : retired(0), jit_mode(JitMode::Off), jit_mismatches(0), profiler(nullptr), regs(r), mem(m), isa(Isa::Bytecode), opt_mode(OptMode::Off),
+      blocks_changed(false) {
+    // A write into a page holding translated code drops the blocks built from it
+    mem.on_code_write = [this](uint32_t page_addr) {
+        dropBlocks(page_addr, page_addr + (Memory::PAGE_SIZE - 1));
+    };
+}
+
+Interpreter::~Interpreter() {
+    mem.on_code_write = nullptr;
+}
+
+// Drops every block (the program was cleared or replaced)
+void Interpreter::invalidateAll() {
+    dropBlocks(0, UINT32_MAX);
+    mem.unwatchCode();
+    jit.reset();  // Every compiled block was just dropped
+}
+
+// Switches the instruction set blocks are decoded from
+void Interpreter::setIsa(Isa new_isa) {
+    if (new_isa == isa) return;
+    isa = new_isa;
+    invalidateAll();
+}
+
+// Switches the optimizer; blocks are rebuilt with or without their optimized form
+void Interpreter::setOptMode(OptMode mode) {
+    if (mode == opt_mode) return;
+    opt_mode = mode;
+    invalidateAll();
+}
+
+// Returns the block starting at addr, decoding it from memory on first use
+Interpreter::Block* Interpreter::block(uint32_t addr, uint32_t code_end) {
+    auto& slot = blocks[addr];
+    if (slot) return slot.get();
+
+    auto built = std::make_unique<Block>();
+    built->start = addr;
+    for (uint32_t at = addr; at < code_end; at = addr + built->bytes) {
+        Instruction insn = isa == Isa::X86 ? X86Decoder::decode(mem, at) : Bytecode::decode(mem, at);
+        if (insn.op == Opcode::Text || insn.op == Opcode::Invalid) {  // Runs outside the interpreter, or not at all
+            if (built->insns.empty()) built->stop = insn.op == Opcode::Text ? Exit::Text : Exit::Fault;
+            break;
+        }
+        insn.handler = handlerFor(insn);
+        built->insns.push_back(insn);
+        built->bytes += insn.length;
+        if (insn.op >= Opcode::Je && insn.op <= Opcode::Jbe) break;
+        if (insn.op == Opcode::Jmp || insn.op == Opcode::Call || insn.op == Opcode::Ret || insn.op == Opcode::Hlt) {
+            built->dynamic = insn.op == Opcode::Ret || insn.dst.kind != OperandKind::Imm;  // Target read at run time
+            break;
+        }
+        if (insn.op != Opcode::Cmp && insn.dst.kind == OperandKind::Reg &&
+            (insn.dst.reg == Reg::EIP || insn.dst.reg == Reg::IP)) {
+            built->dynamic = true;
+            break;
+        }
+    }
+    if (opt_mode != OptMode::Off && !built->insns.empty()) {
+        built->optimized = Optimizer::optimize(built->insns);
+        for (Instruction& insn : built->optimized) insn.handler = handlerFor(insn);
+        if (opt_mode == OptMode::Dump) fputs(Optimizer::dump(addr, built->optimized).c_str(), stderr);
+    }
+    mem.watchCode(addr, std::max<uint32_t>(built->bytes, 1));
+    slot = std::move(built);
+    return slot.get();
+}
+
+// Drops every block covering an address in [first, last] and unchains the rest
+// Dropped blocks stay allocated until the next run() in case one is executing
+void Interpreter::dropBlocks(uint32_t first, uint32_t last) {
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        Block* b = it->second.get();
+        if (b->start <= last && static_cast<uint64_t>(b->start) + std::max<uint32_t>(b->bytes, 1) > first) {
+            dropped.push_back(std::move(it->second));
+            it = blocks.erase(it);
+        } else {
+            b->next[0] = b->next[1] = nullptr;  // A successor may have been dropped
+            ++it;
+        }
+    }
+    blocks_changed = true;
+}
+
+// Runs a compiled block for as many whole passes as the budget allows
+// In check mode it runs one pass natively, then replays it interpreted from the
+// same starting state; the interpreter's result is kept and any difference counted
+Jit::Exit Interpreter::runNative(Block* b, uint64_t& budget, uint32_t code_start, uint32_t code_end) {
+    uint64_t len = b->insns.size();
+    if (jit_mode != JitMode::Check) {
+        uint64_t passes = budget / len;
+        Jit::Exit exit = jit.run(b->native, regs, passes);
+        budget -= passes * len;
+        retired += passes * len;
+        return exit;
+    }
+
+    Registers before = regs;
+    uint64_t passes = 1;
+    jit.run(b->native, regs, passes);
+    Registers native = regs;
+
+    regs = before;
+    jit_mode = JitMode::Off;
+    uint64_t count = retired;
+    uint64_t replay = len;
+    run(code_start, code_end, replay);  // Exactly this block, since it is straight-line
+    jit_mode = JitMode::Check;
+    retired = count + len;
+    budget -= len;
+
+    for (int i = 0; i < static_cast<int>(Reg::COUNT); i++) {
+        if (regs.get(static_cast<Reg>(i)) != native.get(static_cast<Reg>(i))) {
+            jit_mismatches++;
+            break;
+        }
+    }
+    return regs.get(Reg::EIP) == b->start + b->bytes ? Jit::FALL_THROUGH : Jit::TAKEN;
+}
+
+// Effective address of a memory operand: base + index * scale + displacement
+uint32_t Interpreter::address(const Operand& op) const {
+    uint32_t addr = op.reg == Reg::NONE ? op.value : regs.get(op.reg) + op.value;
+    if (op.index != Reg::NONE) addr += regs.get(op.index) * op.scale;
+    return addr;
+}
+
+// Value of a register, immediate or memory operand (32-bit, or a byte if byte is set)
+uint32_t Interpreter::load(const Operand& op, bool byte) const {
+    switch (op.kind) {
+        case OperandKind::Reg: return regs.get(op.reg);
+        case OperandKind::Imm: return op.value;
+        case OperandKind::Mem: return mem.read(address(op), byte);
+        default: return 0;
+    }
+}
+
+// Writes a register or memory operand; register views do their own narrowing
+void Interpreter::store(const Operand& op, uint32_t val, bool byte) {
+    if (op.kind == OperandKind::Mem) mem.write(address(op), val, byte);
+    else regs.set(op.reg, val);
+}
+
+// ADD/XOR/SUB/CMP in one operand form; the flag semantics come from Alu<Op>
+// and are only recorded here, then derived when needed
+template <Opcode Op, OperandKind Dst, OperandKind Src, Width W, bool Flags>
+void Interpreter::alu(const Instruction& insn) {
+    constexpr bool Byte = W == Width::Byte;  // 16-bit forms read their memory source whole; the flags only see its low half
+    uint32_t addr = 0;
+    uint32_t val1;
+    if constexpr (Dst == OperandKind::Mem) {
+        addr = address(insn.dst);  // Computed once for the read and the write
+        val1 = mem.read(addr, Byte);
+    } else {
+        val1 = regs.get(insn.dst.reg);
+    }
+    uint32_t val2;
+    if constexpr (Src == OperandKind::Reg) val2 = regs.get(insn.src.reg);
+    else if constexpr (Src == OperandKind::Imm) val2 = insn.src.value;
+    else val2 = mem.read(address(insn.src), Byte);
+
+    uint32_t result_val;
+    if constexpr (Flags) result_val = aluExecute<Op>(regs, val1, val2, W);
+    else result_val = Alu<Op>::apply(val1, val2);
+    if constexpr (Alu<Op>::WRITES) {
+        if constexpr (Dst == OperandKind::Mem) mem.write(addr, result_val, Byte);
+        else regs.set(insn.dst.reg, result_val);
+    }
+}
+
+// CMP/SUB fused with the Jcc after it (Fold::Branch): sets flags as usual, but
+// decides the jump from the operands, sets EIP past both and returns whether it was taken
+template <Opcode Op, OperandKind Dst, OperandKind Src>
+bool Interpreter::compareAndBranch(const Instruction& insn) {
+    uint32_t val1;
+    if constexpr (Dst == OperandKind::Mem) val1 = mem.read(address(insn.dst));
+    else val1 = regs.get(insn.dst.reg);
+    uint32_t val2;
+    if constexpr (Src == OperandKind::Reg) val2 = regs.get(insn.src.reg);
+    else if constexpr (Src == OperandKind::Imm) val2 = insn.src.value;
+    else val2 = mem.read(address(insn.src));
+
+    uint32_t result_val = aluExecute<Op>(regs, val1, val2);
+    if constexpr (Alu<Op>::WRITES) regs.set(insn.dst.reg, result_val);
+
+    const Instruction& jcc = (&insn)[1];
+    bool taken = compareHolds(jumpCondition(jcc.op), val1, val2);
+    regs.set(Reg::EIP, taken ? jcc.dst.value : regs.get(Reg::EIP) + insn.length + jcc.length);
+    return taken;
+}
+
+// Runs instructions from EIP until the program ends, a TEXT record or bytes that
+// do not decode are reached (EIP is left on them) or budget instructions have
+// been fetched
+Interpreter::Exit Interpreter::run(uint32_t code_start, uint32_t code_end, uint64_t budget) {
+    return profiler ? execute<true>(code_start, code_end, budget) : execute<false>(code_start, code_end, budget);
+}
+
+// Counts the instruction at EIP for PROFILE; calls and returns also move the profiler's call stack
+void Interpreter::profile(const Instruction& insn) {
+    profiler->count(regs.get(Reg::EIP), insn);
+    if (insn.op == Opcode::Call) profiler->call(load(insn.dst));
+    else if (insn.op == Opcode::Ret) profiler->ret();
+}
+
+// The dispatch loop behind run()
+// Handlers are labels indexed by Instruction::handler and return nothing; each one ends by
+// dispatching the next instruction of its block itself, and the last one of a
+// block follows the chained successor, looking it up only on first use
+template <bool Profile>
+Interpreter::Exit Interpreter::execute(uint32_t code_start, uint32_t code_end, uint64_t budget) {
+    dropped.clear();  // Nothing from an earlier run is executing any more
+    Block* current = nullptr;
+    const Instruction* insn;
+    const Instruction* end;
+    bool taken = false;
+
+#if THREADED_DISPATCH
+#define ALU_ENTRY(OP, D, S, W, F) &&op_##OP##_##D##_##S##_##W##_##F,
+#define FUSED_ENTRY(OP, D, S) &&op_fused_##OP##_##D##_##S,
+    static const void* const HANDLERS[] = {  // Same order as Opcode, then the ALU forms
+        &&op_mov, &&op_movb,
+        &&op_text, &&op_text, &&op_text, &&op_text,  // ALU opcodes always dispatch to one of their forms
+        &&op_push, &&op_pop,
+        &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc, &&op_jcc,
+        &&op_jmp, &&op_call, &&op_ret, &&op_inc, &&op_dec, &&op_nop, &&op_hlt,
+        &&op_text, &&op_text,
+        ALU_VARIANTS(ALU_ENTRY)
+        FUSED_VARIANTS(FUSED_ENTRY)
+        &&op_clear
+    };
+#undef ALU_ENTRY
+#undef FUSED_ENTRY
+    static_assert(sizeof(HANDLERS) / sizeof(HANDLERS[0]) == HANDLER_COUNT,
+                  "HANDLERS must cover every handler number");
+#define JUMP_TO_HANDLER() goto *HANDLERS[insn->handler]
+#else
+#define JUMP_TO_HANDLER() goto dispatch
+#endif
+
+#define DISPATCH()                                                        \
+    do {                                                                  \
+        if constexpr (Profile) profile(*insn);                            \
+        JUMP_TO_HANDLER();                                                \
+    } while (0)
+
+// Moves to the next instruction of the block, or on to the next block
+// A write that dropped blocks ends the current one early
+#define NEXT()                                                            \
+    do {                                                                  \
+        if (++insn == end || blocks_changed) goto block_end;              \
+        if (budget == 0) return Exit::Budget;                             \
+        budget--;                                                         \
+        retired++;                                                        \
+        DISPATCH();                                                       \
+    } while (0)
+
+// Reads EIP back so an instruction that wrote it (e.g. MOV EIP x) still steps past, as RUN always did
+#define STEP()                                                            \
+    do {                                                                  \
+        regs.set(Reg::EIP, regs.get(Reg::EIP) + insn->length);            \
+        NEXT();                                                           \
+    } while (0)
+
+lookup: {
+    uint32_t eip = regs.get(Reg::EIP);
+    if (eip < code_start || eip >= code_end) return Exit::End;
+    Block* found = block(eip, code_end);
+    if (current && !current->dynamic && !blocks_changed) current->next[taken] = found;  // Chain it
+    current = found;
+}
+
+enter_block:
+    blocks_changed = false;
+    if (budget == 0) return Exit::Budget;
+    if (!Profile && jit_mode != JitMode::Off && !current->insns.empty()) {
+        if (!current->jit_tried && ++current->runs > JIT_THRESHOLD) {
+            current->jit_tried = true;
+            current->native = jit.compile(current->insns, current->start);
+        }
+        if (current->native.code && budget >= current->insns.size()) {
+            Jit::Exit exit = runNative(current, budget, code_start, code_end);
+            taken = exit != Jit::FALL_THROUGH;  // A budget exit re-enters the same block, as a taken self-loop
+            goto chain;
+        }
+    }
+    budget--;
+    retired++;
+    if (current->insns.empty()) return current->stop;  // Counted already; the caller handles it
+    {
+        // The optimized form is only exact at its end, so it runs when it can reach it
+        // Profiling counts the instructions as written, so it never uses it
+        const std::vector<Instruction>& code =
+            !Profile && !current->optimized.empty() && budget >= current->optimized.size() - 1 ? current->optimized
+                                                                                               : current->insns;
+        insn = code.data();
+        end = insn + code.size();
+    }
+    DISPATCH();
+
+block_end:
+    taken = false;
+chain:
+    if (blocks_changed || current->dynamic || !current->next[taken]) goto lookup;
+    current = current->next[taken];
+    goto enter_block;
+
+#if !THREADED_DISPATCH
+dispatch:
+    switch (insn->handler) {
+#define ALU_CASE(OP, D, S, W, F) \
+        case aluHandler(Opcode::OP, OperandKind::D, OperandKind::S, Width::W, F): goto op_##OP##_##D##_##S##_##W##_##F;
+#define FUSED_CASE(OP, D, S) \
+        case fusedHandler(Opcode::OP, OperandKind::D, OperandKind::S): goto op_fused_##OP##_##D##_##S;
+        ALU_VARIANTS(ALU_CASE)
+        FUSED_VARIANTS(FUSED_CASE)
+#undef ALU_CASE
+#undef FUSED_CASE
+        case CLEAR: goto op_clear;
+        default: break;
+    }
+    switch (insn->op) {
+        case Opcode::Mov: goto op_mov;
+        case Opcode::Movb: goto op_movb;
+        case Opcode::Push: goto op_push;
+        case Opcode::Pop: goto op_pop;
+        case Opcode::Jmp: goto op_jmp;
+        case Opcode::Call: goto op_call;
+        case Opcode::Ret: goto op_ret;
+        case Opcode::Inc: goto op_inc;
+        case Opcode::Dec: goto op_dec;
+        case Opcode::Nop: goto op_nop;
+        case Opcode::Hlt: goto op_hlt;
+        case Opcode::Text: goto op_text;
+        case Opcode::Invalid: goto op_text;
+        default: goto op_jcc;
+    }
+#endif
+
+op_mov:
+    store(insn->dst, load(insn->src, insn->byte()), insn->byte());
+    STEP();
+
+op_movb:
+    if (insn->dst.kind == OperandKind::Mem) mem.write(address(insn->dst), insn->src.value, true);
+    else regs.set(insn->dst.reg, mem.read(address(insn->src), true));
+    STEP();
+
+#define ALU_HANDLER(OP, D, S, W, F)                                       \
+op_##OP##_##D##_##S##_##W##_##F:                                          \
+    alu<Opcode::OP, OperandKind::D, OperandKind::S, Width::W, F>(*insn);   \
+    STEP();
+    ALU_VARIANTS(ALU_HANDLER)
+#undef ALU_HANDLER
+
+// Always second to last in its block; retires the Jcc after it too
+#define FUSED_HANDLER(OP, D, S)                                           \
+op_fused_##OP##_##D##_##S:                                                \
+    taken = compareAndBranch<Opcode::OP, OperandKind::D, OperandKind::S>(*insn); \
+    budget--;                                                             \
+    retired++;                                                            \
+    goto chain;
+    FUSED_VARIANTS(FUSED_HANDLER)
+#undef FUSED_HANDLER
+
+op_clear:
+    regs.set(insn->dst.reg, 0);
+    regs.recordFlags(FlagOp::Logic, 0, 0, 0);
+    STEP();
+
+op_push: {
+    uint32_t val = load(insn->dst);
+    uint32_t esp = regs.get(Reg::ESP);
+    if (mem.push(esp, val)) regs.set(Reg::ESP, esp);  // Silently skipped on overflow, as in cmdPush
+    STEP();
+}
+
+op_pop: {
+    uint32_t esp = regs.get(Reg::ESP);
+    uint32_t val;
+    if (mem.pop(esp, val)) {  // Silently skipped on underflow, as in cmdPop
+        regs.set(Reg::ESP, esp);
+        store(insn->dst, val);
+    }
+    STEP();
+}
+
+op_inc:
+op_dec: {
+    uint32_t val = load(insn->dst, insn->byte());
+    uint32_t result_val = insn->op == Opcode::Inc ? val + 1 : val - 1;
+    regs.recordStepFlags(insn->op == Opcode::Inc ? FlagOp::Inc : FlagOp::Dec, val, result_val, insn->width);
+    store(insn->dst, result_val, insn->byte());
+    STEP();
+}
+
+op_nop:
+    STEP();
+
+op_jcc:
+    // Always the last instruction of its block; not-taken jumps fall through to the next one
+    taken = regs.test(jumpCondition(insn->op));
+    if constexpr (Profile) profiler->branch(regs.get(Reg::EIP), taken, insn->dst.value);
+    regs.set(Reg::EIP, taken ? insn->dst.value : regs.get(Reg::EIP) + insn->length);
+    goto chain;
+
+// JMP, CALL and RET end their block; direct targets are chained like taken jumps
+op_jmp:
+    if constexpr (Profile) profiler->branch(regs.get(Reg::EIP), true, load(insn->dst));
+    regs.set(Reg::EIP, load(insn->dst));
+    taken = true;
+    goto chain;
+
+op_call: {
+    uint32_t target = load(insn->dst);  // Read before the push, which may move ESP
+    uint32_t esp = regs.get(Reg::ESP);
+    if (mem.push(esp, regs.get(Reg::EIP) + insn->length)) regs.set(Reg::ESP, esp);
+    regs.set(Reg::EIP, target);
+    taken = true;
+    goto chain;
+}
+
+op_ret: {
+    uint32_t esp = regs.get(Reg::ESP);
+    uint32_t target;
+    if (!mem.pop(esp, target)) return Exit::End;  // Returning with an empty stack ends the program
+    regs.set(Reg::ESP, esp + insn->src.value);
+    regs.set(Reg::EIP, target);
+    taken = true;
+    goto chain;
+}
+
+op_hlt:
+    regs.set(Reg::EIP, regs.get(Reg::EIP) + insn->length);
+    return Exit::End;
+
+op_text:
+    return Exit::Text;  // Blocks never contain TEXT records or undecodable bytes
+
+#undef STEP
+#undef NEXT
+#undef DISPATCH
+#undef JUMP_TO_HANDLER
+}
@@ -0,0 +1,223 @@
+#include "Jit.hpp"
+#include <cctype>
+#include <cstring>
+#include <sys/mman.h>  // For mmap/mprotect of the code buffer
+
+namespace {
+
+const size_t BUFFER_SIZE = 1 << 20;  // 1 MiB of code; blocks that do not fit stay interpreted
+
+// Layout of the context the generated code receives in RDI
+struct Context {
+    uint32_t* regs;   // +0: register file slots
+    uint64_t passes;  // +8: in: passes allowed (>= 1); out: passes left
+    uint32_t flags;   // +16: FLAGS in (if read) and out (if written)
+};
+static_assert(offsetof(Context, passes) == 8 && offsetof(Context, flags) == 16, "offsets are baked into the code");
+
+const uint32_t ARITH_FLAGS = LazyFlags::CF | LazyFlags::PF | LazyFlags::AF |
+                             LazyFlags::ZF | LazyFlags::SF | LazyFlags::OF;  // Same bits as host EFLAGS
+
+// x86 condition code for each Cond, for Jcc rel32 (0F 80+cc)
+const uint8_t CONDITION_CODES[] = {
+    0x4, 0x5,            // E, NE
+    0xF, 0xC, 0xD, 0xE,  // G, L, GE, LE
+    0x7, 0x2, 0x3, 0x6   // A, B, AE, BE
+};
+
+// Appends machine code bytes
+struct Emitter {
+    std::vector<uint8_t> code;
+
+    void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) code.push_back((v >> (i * 8)) & 0xFF);
+    }
+    size_t rel32() {  // Reserves a rel32 field; returns its position for patch()
+        u32(0);
+        return code.size() - 4;
+    }
+    void patch(size_t at, size_t target) {  // Points a rel32 field at target
+        uint32_t rel = static_cast<uint32_t>(target - (at + 4));
+        std::memcpy(&code[at], &rel, 4);
+    }
+};
+
+// [rsi + disp8] addressing of a register slot, with reg_field in ModRM.reg
+uint8_t slotModRM(uint8_t reg_field) {
+    return 0x40 | (reg_field << 3) | 0x6;
+}
+
+bool isGpr(const Operand& op) {
+    return op.kind == OperandKind::Reg && op.reg <= Reg::EDI;
+}
+
+}  // namespace
+
+Jit::Jit() : buffer(nullptr), used(0) {}
+
+Jit::~Jit() {
+    if (buffer) munmap(buffer, BUFFER_SIZE);
+}
+
+bool Jit::available() {
+#if defined(__x86_64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Jit::parseMode(const std::string& word, JitMode& mode) {
+    std::string upper = word;
+    for (char& c : upper) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    if (upper == "OFF") mode = JitMode::Off;
+    else if (upper == "ON") mode = JitMode::On;
+    else if (upper == "CHECK") mode = JitMode::Check;
+    else return false;
+    return true;
+}
+
+const char* Jit::modeName(JitMode mode) {
+    switch (mode) {
+        case JitMode::On: return "ON";
+        case JitMode::Check: return "CHECK";
+        default: return "OFF";
+    }
+}
+
+// Discards all compiled code; the caller has dropped every Compiled it held
+void Jit::reset() {
+    used = 0;
+}
+
+// Translates a block, or returns an empty Compiled if any instruction is unsupported
+Jit::Compiled Jit::compile(const std::vector<Instruction>& insns, uint32_t start_eip) {
+    Compiled result;
+    if (!available() || insns.empty()) return result;
+
+    for (const Instruction& insn : insns) {
+        switch (insn.op) {
+            case Opcode::Mov:
+            case Opcode::Add:
+            case Opcode::Xor:
+            case Opcode::Sub:
+            case Opcode::Cmp:
+                if (insn.width != Width::Dword) return result;
+                if (!isGpr(insn.dst) || !(isGpr(insn.src) || insn.src.kind == OperandKind::Imm)) return result;
+                break;
+            default:
+                if (insn.op >= Opcode::Je && insn.op <= Opcode::Jbe) break;
+                return result;  // Memory, PUSH/POP, byte moves and 8/16-bit arithmetic stay interpreted
+        }
+    }
+
+    const uint8_t eip_disp = Registers::VIEWS[static_cast<int>(Reg::EIP)].slot * 4;
+    bool is_logic = false;  // Last flag-setting instruction was XOR (host AF is undefined there)
+    Emitter e;
+    e.bytes({0x48, 0x8B, 0x37});        // mov rsi, [rdi]      ; register file
+    e.bytes({0x48, 0x8B, 0x4F, 0x08});  // mov rcx, [rdi+8]    ; passes left
+    size_t flags_load = e.code.size();  // Guest FLAGS are loaded here if the jump needs them
+    size_t loop_top = e.code.size();
+
+    const Instruction* jump = nullptr;
+    for (const Instruction& insn : insns) {
+        if (insn.op >= Opcode::Je && insn.op <= Opcode::Jbe) {
+            jump = &insn;
+            if (!result.writes_flags) result.reads_flags = true;
+            break;  // Always last
+        }
+        uint8_t dst = static_cast<uint8_t>(insn.dst.reg) * 4;
+        // Opcode extension (reg, imm form: 81 /n) and opcode (reg, reg form: op [rsi+d], eax)
+        uint8_t ext = 0, rr = 0;
+        switch (insn.op) {
+            case Opcode::Add: ext = 0; rr = 0x01; break;
+            case Opcode::Sub: ext = 5; rr = 0x29; break;
+            case Opcode::Xor: ext = 6; rr = 0x31; break;
+            case Opcode::Cmp: ext = 7; rr = 0x39; break;
+            default: break;  // Mov
+        }
+        if (insn.op != Opcode::Mov) {
+            result.writes_flags = true;
+            is_logic = insn.op == Opcode::Xor;
+        }
+        if (insn.src.kind == OperandKind::Imm) {
+            if (insn.op == Opcode::Mov) e.bytes({0xC7, slotModRM(0), dst});  // mov dword [rsi+dst], imm32
+            else e.bytes({0x81, slotModRM(ext), dst});                       // op dword [rsi+dst], imm32
+            e.u32(insn.src.value);
+        } else {
+            uint8_t src = static_cast<uint8_t>(insn.src.reg) * 4;
+            e.bytes({0x8B, slotModRM(0), src});                               // mov eax, [rsi+src]
+            e.bytes({insn.op == Opcode::Mov ? uint8_t(0x89) : rr, slotModRM(0), dst});  // op [rsi+dst], eax
+        }
+    }
+
+    if (result.reads_flags) {
+        // mov eax, [rdi+16] ; push rax ; popfq  -- run() masks it to the arithmetic bits first
+        e.code.insert(e.code.begin() + flags_load, {0x8B, 0x47, 0x10, 0x50, 0x9D});
+        loop_top += 5;
+    }
+
+    // Leaves with EIP = eip and the given exit code, storing flags and passes left
+    auto epilogue = [&](uint32_t eip, Exit exit) {
+        e.bytes({0xC7, slotModRM(0), eip_disp});  // mov dword [rsi+EIP], eip
+        e.u32(eip);
+        if (result.writes_flags) {
+            e.bytes({0x9C, 0x58, 0x25});  // pushfq ; pop rax ; and eax, mask
+            e.u32(is_logic ? ARITH_FLAGS & ~LazyFlags::AF : ARITH_FLAGS);
+            e.bytes({0x89, 0x47, 0x10});  // mov [rdi+16], eax
+        }
+        e.bytes({0x48, 0x89, 0x4F, 0x08});  // mov [rdi+8], rcx
+        e.bytes({0xB8});                    // mov eax, exit
+        e.u32(exit);
+        e.bytes({0xC3});                    // ret
+    };
+
+    uint32_t next_eip = start_eip;
+    for (const Instruction& insn : insns) next_eip += insn.length;
+    if (!jump) {
+        epilogue(next_eip, FALL_THROUGH);
+    } else {
+        e.bytes({0x0F, static_cast<uint8_t>(0x80 | CONDITION_CODES[static_cast<int>(jumpCondition(jump->op))])});
+        size_t taken = e.rel32();
+        epilogue(next_eip, FALL_THROUGH);
+        e.patch(taken, e.code.size());
+        if (jump->dst.value == start_eip) {
+            // Loop back while passes remain; neither instruction touches the guest flags
+            e.bytes({0x48, 0x8D, 0x49, 0xFF});  // lea rcx, [rcx-1]
+            e.bytes({0xE3, 0x05});              // jrcxz +5 (over the jmp)
+            e.bytes({0xE9});                    // jmp loop_top
+            e.patch(e.rel32(), loop_top);
+            epilogue(start_eip, BUDGET);
+        } else {
+            epilogue(jump->dst.value, TAKEN);
+        }
+    }
+
+    if (!buffer) {
+        void* mapped = mmap(nullptr, BUFFER_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) return result;
+        buffer = static_cast<uint8_t*>(mapped);
+    }
+    if (used + e.code.size() > BUFFER_SIZE) return result;  // Full until the next reset()
+
+    // Writable only while copying code in
+    if (mprotect(buffer, BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0) return result;
+    std::memcpy(buffer + used, e.code.data(), e.code.size());
+    mprotect(buffer, BUFFER_SIZE, PROT_READ | PROT_EXEC);
+    result.code = reinterpret_cast<int (*)(void*)>(buffer + used);
+    used += (e.code.size() + 15) & ~size_t(15);  // Keep entry points 16-byte aligned
+    return result;
+}
+
+// Runs a compiled block against the register file for at most passes passes
+// On return passes holds how many passes ran
+Jit::Exit Jit::run(const Compiled& block, Registers& regs, uint64_t& passes) {
+    Context context{regs.values.data(), passes, 0};
+    // MOV FLAGS can set any bit, and TF, DF or IF must never reach the host's EFLAGS
+    if (block.reads_flags) context.flags = regs.get(Reg::FLAGS) & ARITH_FLAGS;
+    Exit exit = static_cast<Exit>(block.code(&context));
+    if (block.writes_flags) regs.set(Reg::FLAGS, context.flags);
+    passes = exit == BUDGET ? passes : passes - context.passes + 1;
+    return exit;
+}
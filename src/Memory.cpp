@@ -1,7 +1,8 @@
 #include "Memory.hpp"
+#include <cstring>  // For memcpy/memset in readBytes
 
 // Constructor for Memory class
-// Initializes memory with a default value (likely unused in this context due to map-based implementation)
+// Initializes memory with a default value (likely unused in this context due to page-based implementation)
 Memory::Memory(uint32_t value) : value_(value) {}
 
 // Getter for the stored value_ member
@@ -16,55 +17,221 @@ void Memory::setValue(uint32_t value) {
    value_ = value;  // Sets the internal 32-bit value
 }
 
+// Returns the page holding addr, or nullptr if it was never written
+// Untouched pages are not allocated and read back as zero
+const uint8_t* Memory::pageFor(uint32_t addr) const {
+    if (addr >= STACK_BASE) {  // Stack segment: pages below the grown part are untouched
+        size_t index = stackIndex(addr);
+        return index < stack_.size() && stack_[index] ? stack_[index]->data() : nullptr;
+    }
+    const auto& table = directory_[addr >> (PAGE_SHIFT + TABLE_SHIFT)];  // Top 10 bits select the table
+    if (!table) return nullptr;
+    const auto& page = (*table)[(addr >> PAGE_SHIFT) & (TABLE_SIZE - 1)];  // Next 10 bits select the page
+    return page ? page->data() : nullptr;
+}
+
+// Returns the page holding addr, allocating the table and page on first touch
+// A table or page still shared with a snapshot is copied before it is modified
+uint8_t* Memory::pageForWrite(uint32_t addr) {
+    if (!code_pages_.empty() && code_pages_[addr >> PAGE_SHIFT]) codeWritten(addr);
+    if (addr >= STACK_BASE) return stackForWrite(addr & ~(PAGE_SIZE - 1));
+    auto& table = directory_[addr >> (PAGE_SHIFT + TABLE_SHIFT)];
+    if (!table) table = std::make_shared<PageTable>();  // Value-initialized: all page pointers null
+    else if (table.use_count() > 1) table = std::make_shared<PageTable>(*table);  // Unshare the table
+    auto& page = (*table)[(addr >> PAGE_SHIFT) & (TABLE_SIZE - 1)];
+    if (!page) page = std::make_shared<Page>();  // Value-initialized: all bytes zero
+    else if (page.use_count() > 1) page = std::make_shared<Page>(*page);  // Unshare the page
+    return page->data();
+}
+
+// Returns the stack byte at addr, allocating its page on first touch
+// A page still shared with a snapshot is copied before it is modified
+uint8_t* Memory::stackForWrite(uint32_t addr) {
+    size_t index = stackIndex(addr);
+    if (index >= stack_.size()) stack_.resize(index + 1);  // New pages go below the old ones
+    auto& page = stack_[index];
+    if (!page) page = std::make_shared<Page>();
+    else if (page.use_count() > 1) page = std::make_shared<Page>(*page);
+    return page->data() + (addr & (PAGE_SIZE - 1));
+}
+
+// Captures the current memory image: every table and page, stack pages
+// included, is shared in O(tables + stack pages) and copied on later writes
+Memory::Snapshot Memory::snapshot() const {
+    return Snapshot{directory_, stack_};
+}
+
+// Rolls memory back to a previously captured snapshot
+// The snapshot stays valid and can be restored again
+void Memory::restore(const Snapshot& snap) {
+    directory_ = snap.directory;
+    stack_ = snap.stack;
+}
+
 // Writes a value to memory at the specified address
 // Supports both byte (8-bit) and word (32-bit) writes
 void Memory::write(uint32_t addr, uint32_t val, bool is_byte) {
+    uint32_t offset = addr & (PAGE_SIZE - 1);  // Byte offset within the page
     if (is_byte) {  // Byte write mode
-        mem[addr] = val & 0xFF;  // Store only the least significant byte (8 bits)
-    } else {  // Word write mode (32-bit)
-        mem[addr] = val & 0xFF;              // Store byte 0 (LSB)
-        mem[addr + 1] = (val >> 8) & 0xFF;  // Store byte 1
-        mem[addr + 2] = (val >> 16) & 0xFF; // Store byte 2
-        mem[addr + 3] = (val >> 24) & 0xFF; // Store byte 3 (MSB)
+        pageForWrite(addr)[offset] = val & 0xFF;  // Store only the least significant byte (8 bits)
+    } else if (offset <= PAGE_SIZE - 4) {  // Word write mode (32-bit), fits in one page
+        uint8_t* page = pageForWrite(addr);
+        page[offset] = val & 0xFF;              // Store byte 0 (LSB)
+        page[offset + 1] = (val >> 8) & 0xFF;  // Store byte 1
+        page[offset + 2] = (val >> 16) & 0xFF; // Store byte 2
+        page[offset + 3] = (val >> 24) & 0xFF; // Store byte 3 (MSB)
+    } else {  // Word straddles a page boundary (or wraps at 4 GiB): store byte by byte
+        for (uint32_t i = 0; i < 4; i++) {
+            write(addr + i, (val >> (i * 8)) & 0xFF, true);
+        }
     }
 }
 
 // Reads a value from memory at the specified address
 // Supports both byte (8-bit) and word (32-bit) reads
 uint32_t Memory::read(uint32_t addr, bool is_byte) const {
+    uint32_t offset = addr & (PAGE_SIZE - 1);  // Byte offset within the page
     if (is_byte) {  // Byte read mode
-        // Return the byte at addr if it exists, otherwise return 0
-        return mem.count(addr) ? mem.at(addr) & 0xFF : 0;
+        // Return the byte at addr if its page exists, otherwise return 0
+        const uint8_t* page = pageFor(addr);
+        return page ? page[offset] : 0;
+    }
+    if (offset > PAGE_SIZE - 4) {  // Word straddles a page boundary: assemble byte by byte
+        uint32_t val = 0;
+        for (uint32_t i = 0; i < 4; i++) {
+            val |= read(addr + i, true) << (i * 8);
+        }
+        return val;
     }
+    const uint8_t* page = pageFor(addr);
+    if (!page) return 0;  // Whole word lies in an untouched page
     uint32_t val = 0;  // Word read mode (32-bit)
-    // Reconstruct 32-bit value from 4 consecutive bytes, defaulting to 0 if byte not present
-    val |= (mem.count(addr) ? mem.at(addr) : 0);                // Byte 0 (LSB)
-    val |= (mem.count(addr + 1) ? mem.at(addr + 1) : 0) << 8;  // Byte 1
-    val |= (mem.count(addr + 2) ? mem.at(addr + 2) : 0) << 16; // Byte 2
-    val |= (mem.count(addr + 3) ? mem.at(addr + 3) : 0) << 24; // Byte 3 (MSB)
+    // Reconstruct 32-bit value from 4 consecutive bytes
+    val |= page[offset];                                       // Byte 0 (LSB)
+    val |= static_cast<uint32_t>(page[offset + 1]) << 8;       // Byte 1
+    val |= static_cast<uint32_t>(page[offset + 2]) << 16;      // Byte 2
+    val |= static_cast<uint32_t>(page[offset + 3]) << 24;      // Byte 3 (MSB)
     return val;  // Return the reconstructed 32-bit value
 }
 
 // Erases a specific memory address
+// The byte reads back as zero; the page itself stays allocated
 void Memory::erase(uint32_t addr) {
-    mem.erase(addr);  // Remove the byte at the specified address from the map
+    if (pageFor(addr)) write(addr, 0, true);  // Untouched pages already read as zero
+}
+
+// Pushes val onto the stack at esp - 4, as PUSH does
+// Returns false (leaving esp and memory alone) when esp is already at STACK_BASE
+bool Memory::push(uint32_t& esp, uint32_t val) {
+    if (esp <= STACK_BASE) return false;  // Overflow
+    esp -= 4;
+    if (esp < STACK_BASE || (esp & (PAGE_SIZE - 1)) > PAGE_SIZE - 4) {  // Misaligned ESP straddling a page
+        write(esp, val);
+        return true;
+    }
+    uint8_t* slot = stackForWrite(esp);
+    slot[0] = val & 0xFF;
+    slot[1] = (val >> 8) & 0xFF;
+    slot[2] = (val >> 16) & 0xFF;
+    slot[3] = (val >> 24) & 0xFF;
+    return true;
+}
+
+// Pops the word at esp into val and zeroes the vacated slot, as POP does
+// Returns false when esp is already at STACK_TOP (nothing to pop)
+bool Memory::pop(uint32_t& esp, uint32_t& val) {
+    if (esp > STACK_TOP - 4) return false;  // Underflow
+    if (esp < STACK_BASE || (esp & (PAGE_SIZE - 1)) > PAGE_SIZE - 4) {  // Outside the segment, or straddling a page
+        val = read(esp);
+        for (uint32_t i = 0; i < 4; i++) erase(esp + i);
+    } else if (pageFor(esp)) {
+        uint8_t* slot = stackForWrite(esp);
+        val = slot[0] | (slot[1] << 8) | (slot[2] << 16) | (static_cast<uint32_t>(slot[3]) << 24);
+        std::memset(slot, 0, 4);
+    } else {
+        val = 0;  // In a page nothing was ever pushed to
+    }
+    esp += 4;
+    return true;
 }
 
 // Clears all memory contents
 void Memory::clear() {
-    mem.clear();  // Remove all entries from the memory map
+    for (auto& table : directory_) {
+        table.reset();  // Release every page table along with its pages
+    }
+    std::vector<std::shared_ptr<Page>>().swap(stack_);  // Release the stack pages too
 }
 
 // Returns a map of all memory bytes
-// Converts internal memory representation to a byte-wise map
+// Converts internal memory representation to a byte-wise map (non-zero bytes of allocated pages)
 std::map<uint32_t, uint8_t> Memory::getAllBytes() const {
     std::map<uint32_t, uint8_t> byteMap;  // Resulting byte map
-    for (const auto& pair : mem) {  // Iterate over internal memory map
-        byteMap[pair.first] = static_cast<uint8_t>(pair.second & 0xFF);  // Store each byte
-    }
+    forEachPage([&byteMap](uint32_t base, const Page& page) {  // Walk every allocated page
+        for (uint32_t i = 0; i < PAGE_SIZE; i++) {
+            if (page[i]) byteMap[base + i] = page[i];  // Store each populated byte
+        }
+    });
     return byteMap;  // Return the byte-wise memory map
 }
 
+// Installs an externally owned page (e.g. one backed by a mapped image file) at addr
+// The page is treated as shared and copied on first write if anyone else holds it
+void Memory::mapPage(uint32_t addr, std::shared_ptr<Page> page) {
+    if (addr >= STACK_BASE) {
+        size_t index = stackIndex(addr);
+        if (index >= stack_.size()) stack_.resize(index + 1);
+        stack_[index] = std::move(page);
+        return;
+    }
+    auto& table = directory_[addr >> (PAGE_SHIFT + TABLE_SHIFT)];
+    if (!table) table = std::make_shared<PageTable>();
+    else if (table.use_count() > 1) table = std::make_shared<PageTable>(*table);
+    (*table)[(addr >> PAGE_SHIFT) & (TABLE_SIZE - 1)] = std::move(page);
+}
+
+// Marks the pages holding [addr, addr + len) as containing translated code
+void Memory::watchCode(uint32_t addr, uint32_t len) {
+    if (code_pages_.empty()) code_pages_.resize(size_t(1) << (32 - PAGE_SHIFT), false);
+    uint64_t end = static_cast<uint64_t>(addr) + len;
+    for (uint64_t page = addr >> PAGE_SHIFT; page << PAGE_SHIFT < end; page++) {
+        code_pages_[page & ((size_t(1) << (32 - PAGE_SHIFT)) - 1)] = true;  // Wraps at 4 GiB like every access
+    }
+}
+
+// Unmarks every code page (all translations were dropped)
+void Memory::unwatchCode() {
+    code_pages_.clear();
+}
+
+// A write is about to hit a watched page: unmark it, then report it
+void Memory::codeWritten(uint32_t addr) {
+    code_pages_[addr >> PAGE_SHIFT] = false;
+    if (on_code_write) on_code_write(addr & ~(PAGE_SIZE - 1));
+}
+
+// Copies [addr, addr + len) into a caller-provided buffer, zero-filling untouched pages
+// Costs O(len) regardless of how much memory is populated
+void Memory::readBytes(uint32_t addr, uint8_t* out, uint32_t len) const {
+    visit(addr, len, [&out](uint32_t, const uint8_t* data, uint32_t run) {
+        if (data) std::memcpy(out, data, run);
+        else std::memset(out, 0, run);
+        out += run;
+    });
+}
+
+// Copies len bytes into memory at addr, a page at a time
+void Memory::writeBytes(uint32_t addr, const uint8_t* data, uint32_t len) {
+    while (len > 0) {
+        uint32_t offset = addr & (PAGE_SIZE - 1);
+        uint32_t run = std::min(PAGE_SIZE - offset, len);
+        std::memcpy(pageForWrite(addr) + offset, data, run);
+        addr += run;
+        data += run;
+        len -= run;
+    }
+}
+
 // Returns a map of all memory contents as 32-bit values
 // Note: This function seems inconsistent with the byte-based mem map; possibly outdated or unused
 std::map<uint32_t, uint32_t> Memory::getAll() const {
@@ -78,7 +245,7 @@ std::map<uint32_t, uint32_t> Memory::getAll() const {
 // Writes a string to memory as consecutive bytes
 void Memory::writeText(uint32_t addr, const std::string& text) {
     for (size_t i = 0; i < text.length(); i++) {
-        mem[addr + i] = static_cast<uint8_t>(text[i]);  // Write each character as a byte
+        write(addr + i, static_cast<uint8_t>(text[i]), true);  // Write each character as a byte
     }
-    mem[addr + text.length()] = 0;  // Append null terminator byte
+    write(addr + text.length(), 0, true);  // Append null terminator byte
 }
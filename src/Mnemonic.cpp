@@ -0,0 +1,20 @@
+#include "Mnemonic.hpp"
+#include "PerfectHash.hpp"
+
+// Collision-free table over MNEMONIC_NAMES, built at compile time
+static constexpr PerfectHash<MNEMONIC_NAMES.size()> MNEMONIC_TABLE(MNEMONIC_NAMES);
+static_assert(MNEMONIC_TABLE.valid(), "No perfect hash seed for the mnemonic list");
+
+// Maps a command word (any case) to its Mnemonic without allocating
+Mnemonic lookupMnemonic(std::string_view word) {
+    int index = MNEMONIC_TABLE.find(word);
+    return index < 0 ? Mnemonic::NONE : static_cast<Mnemonic>(index);
+}
+
+// Returns the first whitespace-delimited word of a line (a view into it)
+std::string_view firstWord(std::string_view line) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string_view::npos) return {};
+    size_t end = line.find_first_of(" \t", start);
+    return line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+}
@@ -0,0 +1,213 @@
+#include "OperandParser.hpp"
+#include <charconv>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+size_t skipSpaces(std::string_view text, size_t i) {
+    while (i < text.size() && isSpace(text[i])) i++;
+    return i;
+}
+
+// Index just past the quoted string starting at text[i] (the end of text if it is unterminated)
+size_t skipQuoted(std::string_view text, size_t i) {
+    char quote = text[i++];
+    while (i < text.size() && text[i] != quote) i += text[i] == '\\' && i + 1 < text.size() ? 2 : 1;
+    return i < text.size() ? i + 1 : i;
+}
+
+bool fail(ParseError& error, size_t pos, const char* message) {
+    error.pos = pos;
+    error.message = message;
+    return false;
+}
+
+// 'c' or '\e'; the whole of text must be the literal
+bool parseChar(std::string_view text, uint32_t& out, ParseError& error) {
+    if (text.size() < 3) return fail(error, text.size(), "unterminated character");
+    size_t close = 2;
+    if (text[1] == '\\') {
+        switch (text[2]) {
+            case 'n': out = '\n'; break;
+            case 't': out = '\t'; break;
+            case '0': out = 0; break;
+            case '\\': case '\'': case '"': out = static_cast<uint8_t>(text[2]); break;
+            default: return fail(error, 2, "unknown escape");
+        }
+        close = 3;
+    } else {
+        out = static_cast<uint8_t>(text[1]);
+    }
+    if (close >= text.size() || text[close] != '\'') return fail(error, close, "expected closing quote");
+    if (close + 1 != text.size()) return fail(error, close + 1, "unexpected character");
+    return true;
+}
+
+// One factor of a memory term: a register or a number
+bool parseFactor(std::string_view text, Operand& out, ParseError& error) {
+    if (text.empty()) return fail(error, 0, "expected a register or number");
+    Reg reg = Registers::lookup(text);
+    if (reg != Reg::NONE) {
+        out.kind = OperandKind::Reg;
+        out.reg = reg;
+        return true;
+    }
+    out.kind = OperandKind::Imm;
+    return OperandParser::parseNumber(text, out.value, error);
+}
+
+// End of the memory term factor starting at i
+size_t factorEnd(std::string_view text, size_t i, size_t end) {
+    if (i < end && text[i] == '\'') return skipQuoted(text, i);
+    while (i < end && !isSpace(text[i]) && text[i] != '+' && text[i] != '-' && text[i] != '*') i++;
+    return i;
+}
+
+}  // namespace
+
+OperandParser::Words OperandParser::split(std::string_view line) {
+    Words words;
+    size_t i = skipSpaces(line, 0);
+    while (i < line.size() && words.count < MAX_WORDS) {
+        size_t start = i;
+        while (i < line.size() && !isSpace(line[i])) {
+            if (line[i] == '[') {
+                size_t close = line.find(']', i);
+                i = close == std::string_view::npos ? line.size() : close + 1;
+            } else if (line[i] == '"' || line[i] == '\'') {
+                i = skipQuoted(line, i);
+            } else {
+                i++;
+            }
+        }
+        words.word[words.count++] = line.substr(start, i - start);
+        i = skipSpaces(line, i);
+    }
+    return words;
+}
+
+bool OperandParser::parse(std::string_view text, Operand& out, ParseError& error) {
+    if (!text.empty() && text[0] == '[') return parseMemory(text, out, error);
+    if (parseRegister(text, out, error)) return true;
+    if (!parseNumber(text, out.value, error)) return false;
+    out.kind = OperandKind::Imm;
+    return true;
+}
+
+bool OperandParser::parseRegister(std::string_view text, Operand& out, ParseError& error) {
+    Reg reg = Registers::lookup(text);
+    if (reg == Reg::NONE) return fail(error, 0, "expected a register");
+    out.kind = OperandKind::Reg;
+    out.reg = reg;
+    return true;
+}
+
+// Hex unless marked otherwise (see the class comment); values must fit in 32 bits
+bool OperandParser::parseNumber(std::string_view text, uint32_t& out, ParseError& error) {
+    size_t i = 0;
+    bool negative = !text.empty() && text[0] == '-';
+    if (negative) i++;
+    if (i >= text.size()) return fail(error, i, "expected a number");
+
+    uint32_t value = 0;
+    if (text[i] == '\'') {
+        if (!parseChar(text.substr(i), value, error)) {
+            error.pos += i;
+            return false;
+        }
+    } else {
+        int base = 16;
+        if (text[i] == '#') {
+            base = 10;
+            i++;
+        } else if (text.size() - i > 2 && text[i] == '0' && (text[i + 1] == 'x' || text[i + 1] == 'X')) {
+            i += 2;
+        }
+        const char* first = text.data() + i;
+        const char* last = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(first, last, value, base);
+        if (ec == std::errc::invalid_argument) return fail(error, i, "expected a number");
+        if (ec == std::errc::result_out_of_range) return fail(error, i, "value out of range");
+        if (ptr != last) return fail(error, ptr - text.data(), "unexpected character");
+    }
+    out = negative ? 0 - value : value;
+    return true;
+}
+
+// [base + index*scale + disp]; see the class comment
+bool OperandParser::parseMemory(std::string_view text, Operand& out, ParseError& error) {
+    if (text.empty() || text[0] != '[') return fail(error, 0, "expected '['");
+    if (text.back() != ']' || text.size() < 2) return fail(error, text.size(), "expected ']'");
+    size_t end = text.size() - 1;
+
+    Operand mem;
+    mem.kind = OperandKind::Mem;
+    bool negative = false;
+    size_t i = skipSpaces(text, 1);
+    if (i < end && (text[i] == '+' || text[i] == '-')) {  // [-8] is a negative displacement
+        negative = text[i] == '-';
+        i = skipSpaces(text, i + 1);
+    }
+    while (true) {
+        // Term: factor, or factor * factor
+        size_t start = i;
+        size_t stop = factorEnd(text, i, end);
+        Operand first, second;
+        if (!parseFactor(text.substr(start, stop - start), first, error)) {
+            error.pos += start;
+            return false;
+        }
+        i = skipSpaces(text, stop);
+        bool scaled = i < end && text[i] == '*';
+        size_t second_start = i;
+        if (scaled) {
+            second_start = skipSpaces(text, i + 1);
+            stop = factorEnd(text, second_start, end);
+            if (!parseFactor(text.substr(second_start, stop - second_start), second, error)) {
+                error.pos += second_start;
+                return false;
+            }
+            i = skipSpaces(text, stop);
+        }
+
+        if (!scaled && first.kind == OperandKind::Imm) {
+            mem.value += negative ? 0 - first.value : first.value;
+        } else {
+            if (negative) return fail(error, start, "registers cannot be subtracted");
+            Reg reg = first.reg;
+            uint32_t scale = 1;
+            size_t scale_pos = start;
+            if (scaled) {
+                if (first.kind == second.kind) return fail(error, start, "expected register*scale");
+                if (first.kind == OperandKind::Imm) {
+                    reg = second.reg;
+                    scale = first.value;
+                } else {
+                    scale = second.value;
+                    scale_pos = second_start;
+                }
+                if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+                    return fail(error, scale_pos, "scale must be 1, 2, 4 or 8");
+                }
+            }
+            if (!scaled && mem.reg == Reg::NONE) {
+                mem.reg = reg;
+            } else if (mem.index == Reg::NONE) {
+                mem.index = reg;
+                mem.scale = static_cast<uint8_t>(scale);
+            } else {
+                return fail(error, start, "too many registers");
+            }
+        }
+
+        if (i == end) break;
+        if (text[i] != '+' && text[i] != '-') return fail(error, i, "expected '+', '-' or ']'");
+        negative = text[i] == '-';
+        i = skipSpaces(text, i + 1);
+    }
+    out = mem;
+    return true;
+}
@@ -0,0 +1,161 @@
+#include "Optimizer.hpp"
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+// Upper-case spellings, indexed by Opcode
+const char* const OPCODE_NAMES[] = {
+    "MOV", "MOVB", "ADD", "XOR", "SUB", "CMP", "PUSH", "POP",
+    "JE", "JNE", "JG", "JL", "JGE", "JLE", "JA", "JB", "JAE", "JBE",
+    "JMP", "CALL", "RET", "INC", "DEC", "NOP", "HLT",
+    "TEXT", "INVALID"
+};
+static_assert(sizeof(OPCODE_NAMES) / sizeof(OPCODE_NAMES[0]) == static_cast<size_t>(Opcode::Invalid) + 1,
+              "OPCODE_NAMES must cover every Opcode");
+
+bool isAlu(const Instruction& insn) {
+    return insn.op >= Opcode::Add && insn.op <= Opcode::Cmp;
+}
+
+bool isJcc(const Instruction& insn) {
+    return insn.op >= Opcode::Je && insn.op <= Opcode::Jbe;
+}
+
+// FLAGS named as a register operand, or as part of an address: read or written outside the flag model
+bool namesFlags(const Instruction& insn) {
+    return insn.dst.reg == Reg::FLAGS || insn.dst.index == Reg::FLAGS ||
+           insn.src.reg == Reg::FLAGS || insn.src.index == Reg::FLAGS;
+}
+
+// Reads the flags left by earlier instructions (INC/DEC keep CF)
+bool readsFlags(const Instruction& insn) {
+    return isJcc(insn) || insn.op == Opcode::Inc || insn.op == Opcode::Dec || namesFlags(insn);
+}
+
+// May write memory, and so drop the block it is in and end it right after
+bool writesMemory(const Instruction& insn) {
+    switch (insn.op) {
+        case Opcode::Push:
+        case Opcode::Call:
+            return true;
+        case Opcode::Cmp:
+            return false;
+        default:
+            return insn.dst.kind == OperandKind::Mem;
+    }
+}
+
+bool isClear(const Instruction& insn) {
+    return insn.op == Opcode::Xor && insn.width == Width::Dword && insn.dst.kind == OperandKind::Reg &&
+           insn.src.kind == OperandKind::Reg && insn.dst.reg == insn.src.reg;
+}
+
+std::string operandText(const Operand& op) {
+    char buf[48];
+    switch (op.kind) {
+        case OperandKind::Reg:
+            return Registers::name(op.reg);
+        case OperandKind::Imm:
+            snprintf(buf, sizeof(buf), "%X", op.value);
+            return buf;
+        case OperandKind::Mem: {
+            std::string text = "[";
+            if (op.reg != Reg::NONE) text += Registers::name(op.reg);
+            if (op.index != Reg::NONE) {
+                if (text.size() > 1) text += "+";
+                text += Registers::name(op.index);
+                if (op.scale != 1) text += "*" + std::to_string(op.scale);
+            }
+            if (op.value != 0 || text.size() == 1) {
+                snprintf(buf, sizeof(buf), "%s%X", text.size() > 1 ? "+" : "", op.value);
+                text += buf;
+            }
+            return text + "]";
+        }
+        default:
+            return "";
+    }
+}
+
+}  // namespace
+
+bool Optimizer::parseMode(const std::string& word, OptMode& mode) {
+    std::string upper = word;
+    for (char& c : upper) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    if (upper == "OFF") mode = OptMode::Off;
+    else if (upper == "ON") mode = OptMode::On;
+    else if (upper == "DUMP") mode = OptMode::Dump;
+    else return false;
+    return true;
+}
+
+const char* Optimizer::modeName(OptMode mode) {
+    switch (mode) {
+        case OptMode::On: return "ON";
+        case OptMode::Dump: return "DUMP";
+        default: return "OFF";
+    }
+}
+
+// Returns insns rewritten as described in the class comment
+std::vector<Instruction> Optimizer::optimize(const std::vector<Instruction>& insns) {
+    std::vector<Instruction> out = insns;
+
+    // Backwards: flags are live at the end of the block, where a successor may read them
+    bool live = true;
+    for (size_t i = out.size(); i-- > 0;) {
+        Instruction& insn = out[i];
+        if (writesMemory(insn)) live = true;
+        if (isAlu(insn) && !namesFlags(insn)) {
+            if (live) {
+                if (isClear(insn)) insn.fold = Fold::Clear;
+            } else if (insn.op == Opcode::Cmp) {
+                Instruction nop;
+                nop.op = Opcode::Nop;
+                nop.length = insn.length;
+                insn = nop;
+            } else if (isClear(insn)) {
+                insn.op = Opcode::Mov;
+                insn.src = Operand();
+                insn.src.kind = OperandKind::Imm;
+            } else {
+                insn.fold = Fold::Quiet;
+            }
+            live = false;
+        }
+        if (readsFlags(insn)) live = true;
+    }
+
+    // CMP/SUB into a register right before the block's closing Jcc; the jump still counts as retired
+    if (out.size() >= 2 && isJcc(out.back())) {
+        Instruction& insn = out[out.size() - 2];
+        bool compare = insn.op == Opcode::Cmp || (insn.op == Opcode::Sub && insn.dst.kind == OperandKind::Reg);
+        if (compare && insn.fold == Fold::None && insn.width == Width::Dword && !namesFlags(insn)) insn.fold = Fold::Branch;
+    }
+    return out;
+}
+
+// "  00001000  SUB ECX 1  ; flags dead" for each instruction, addressed from start
+std::string Optimizer::dump(uint32_t start, const std::vector<Instruction>& insns) {
+    char line[32];
+    snprintf(line, sizeof(line), "block %08X:\n", start);
+    std::string text = line;
+    uint32_t addr = start;
+    for (const Instruction& insn : insns) {
+        snprintf(line, sizeof(line), "  %08X  ", addr);
+        text += line;
+        text += OPCODE_NAMES[static_cast<size_t>(insn.op)];
+        if (insn.dst.kind != OperandKind::None) text += " " + operandText(insn.dst);
+        if (insn.src.kind != OperandKind::None) text += " " + operandText(insn.src);
+        switch (insn.fold) {
+            case Fold::Quiet: text += "  ; flags dead"; break;
+            case Fold::Clear: text += "  ; clear"; break;
+            case Fold::Branch: text += "  ; fused with next"; break;
+            default: break;
+        }
+        text += "\n";
+        addr += insn.length;
+    }
+    return text;
+}
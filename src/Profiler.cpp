@@ -0,0 +1,214 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// Memory operands and stack slots an instruction reads and writes
+void accesses(const Instruction& insn, uint64_t& reads, uint64_t& writes) {
+    bool dst_mem = insn.dst.kind == OperandKind::Mem;
+    bool src_mem = insn.src.kind == OperandKind::Mem;
+    switch (insn.op) {
+        case Opcode::Mov:
+        case Opcode::Movb:
+            reads += src_mem;
+            writes += dst_mem;
+            break;
+        case Opcode::Add:
+        case Opcode::Xor:
+        case Opcode::Sub:
+        case Opcode::Cmp:
+            if (insn.fold == Fold::Clear) break;
+            reads += dst_mem + src_mem;
+            writes += dst_mem && insn.op != Opcode::Cmp;
+            break;
+        case Opcode::Inc:
+        case Opcode::Dec:
+            reads += dst_mem;
+            writes += dst_mem;
+            break;
+        case Opcode::Push:
+        case Opcode::Call:
+            reads += dst_mem;
+            writes++;
+            break;
+        case Opcode::Pop:
+            reads++;
+            writes += dst_mem;
+            break;
+        case Opcode::Ret:
+            reads++;
+            break;
+        case Opcode::Jmp:
+            reads += dst_mem;
+            break;
+        default:
+            break;
+    }
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+}
+
+}  // namespace
+
+// Clears every count; the call stack starts with the entry point as its only frame
+void Profiler::reset(uint32_t code_start, uint32_t code_end, uint32_t entry) {
+    start = code_start;
+    counts.assign(code_end - code_start, Counts{});
+    total = 0;
+    stack.assign(1, entry);
+    untracked = 0;
+    charged = 0;
+    stack_counts.clear();
+    calls = false;
+}
+
+void Profiler::count(uint32_t addr, const Instruction& insn) {
+    if (addr - start >= counts.size()) return;  // Code past the range the RUN started with
+    Counts& c = counts[addr - start];
+    c.executed++;
+    total++;
+    accesses(insn, c.reads, c.writes);
+    if (insn.op == Opcode::Call || insn.op == Opcode::Ret) c.taken++;
+}
+
+void Profiler::branch(uint32_t addr, bool taken, uint32_t target) {
+    if (addr - start >= counts.size()) return;
+    Counts& c = counts[addr - start];
+    if (taken) {
+        c.taken++;
+        c.target = target;
+    } else {
+        c.not_taken++;
+    }
+}
+
+// Adds the instructions run since the last CALL/RET to the stack they ran under
+void Profiler::charge() {
+    if (total > charged) stack_counts[stack] += total - charged;
+    charged = total;
+}
+
+// The CALL was counted already, so it is charged to the caller
+void Profiler::call(uint32_t target) {
+    charge();
+    calls = true;
+    if (stack.size() < MAX_DEPTH) stack.push_back(target);
+    else untracked++;
+}
+
+// The RET is charged to the function it returns from
+void Profiler::ret() {
+    charge();
+    if (untracked) untracked--;
+    else if (stack.size() > 1) stack.pop_back();
+}
+
+std::string Profiler::report(size_t n, const Program* program) const {
+    std::string out;
+    char line[160];
+    snprintf(line, sizeof(line), "PROFILE: %llu instructions\n", static_cast<unsigned long long>(total));
+    out += line;
+
+    std::vector<uint32_t> hot;
+    for (uint32_t i = 0; i < counts.size(); i++) {
+        if (counts[i].executed) hot.push_back(i);
+    }
+    std::sort(hot.begin(), hot.end(), [this](uint32_t a, uint32_t b) {
+        return counts[a].executed != counts[b].executed ? counts[a].executed > counts[b].executed : a < b;
+    });
+    if (hot.size() > n) hot.resize(n);
+    out += "Hot instructions:\n  Address      Executed       %       Taken   Not taken       Reads      Writes  Line\n";
+    for (uint32_t i : hot) {
+        const Counts& c = counts[i];
+        snprintf(line, sizeof(line), "  %08X  %12llu  %5.1f%%  %10llu  %10llu  %10llu  %10llu", start + i,
+                 static_cast<unsigned long long>(c.executed), percent(c.executed, total),
+                 static_cast<unsigned long long>(c.taken), static_cast<unsigned long long>(c.not_taken),
+                 static_cast<unsigned long long>(c.reads), static_cast<unsigned long long>(c.writes));
+        out += line;
+        for (size_t l = 0; program && l < program->size(); l++) {
+            if (program->addr(l) == start + i) {
+                out += "  ";
+                program->appendLine(l, out);
+                break;
+            }
+        }
+        out += '\n';
+    }
+
+    // A loop is a jump back to (or before) itself; its cost is everything executed in between
+    struct Loop {
+        uint32_t first, last;
+        uint64_t iterations, executed;
+    };
+    std::vector<Loop> loops;
+    for (uint32_t i = 0; i < counts.size(); i++) {
+        const Counts& c = counts[i];
+        if (!c.taken || c.target < start || c.target > start + i) continue;
+        Loop loop{c.target, start + i, c.taken, 0};
+        for (uint32_t j = c.target - start; j <= i; j++) loop.executed += counts[j].executed;
+        loops.push_back(loop);
+    }
+    std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) {
+        return a.executed != b.executed ? a.executed > b.executed : a.first < b.first;
+    });
+    if (loops.size() > n) loops.resize(n);
+    out += "Hot loops:\n  Range                Iterations  Instructions       %\n";
+    for (const Loop& loop : loops) {
+        snprintf(line, sizeof(line), "  %08X-%08X  %12llu  %12llu  %5.1f%%\n", loop.first, loop.last,
+                 static_cast<unsigned long long>(loop.iterations), static_cast<unsigned long long>(loop.executed),
+                 percent(loop.executed, total));
+        out += line;
+    }
+    return out;
+}
+
+std::string Profiler::folded() const {
+    std::string out;
+    char frame[16];
+    if (calls) {
+        std::map<std::vector<uint32_t>, uint64_t> all = stack_counts;
+        if (total > charged) all[stack] += total - charged;
+        for (const auto& [frames, executed] : all) {
+            for (size_t i = 0; i < frames.size(); i++) {
+                snprintf(frame, sizeof(frame), i ? ";%08X" : "%08X", frames[i]);
+                out += frame;
+            }
+            out += ' ' + std::to_string(executed) + '\n';
+        }
+        return out;
+    }
+
+    // Basic blocks: a new one starts at each jump target and after each jump
+    std::vector<bool> leader(counts.size(), false);
+    bool after_branch = true;
+    for (uint32_t i = 0; i < counts.size(); i++) {
+        const Counts& c = counts[i];
+        if (!c.executed) continue;
+        if (after_branch) leader[i] = true;
+        after_branch = c.taken || c.not_taken;
+        if (c.taken && c.target >= start && c.target - start < counts.size()) leader[c.target - start] = true;
+    }
+    uint64_t executed = 0;
+    uint32_t block = 0;
+    for (uint32_t i = 0; i <= counts.size(); i++) {
+        if (i < counts.size() && (!counts[i].executed || !leader[i])) {
+            executed += counts[i].executed;
+            continue;
+        }
+        if (executed) {
+            snprintf(frame, sizeof(frame), "%08X;", stack[0]);
+            out += frame;
+            snprintf(frame, sizeof(frame), "%08X", start + block);
+            out += frame;
+            out += ' ' + std::to_string(executed) + '\n';
+        }
+        if (i < counts.size()) {
+            block = i;
+            executed = counts[i].executed;
+        }
+    }
+    return out;
+}
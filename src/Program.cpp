@@ -0,0 +1,105 @@
+#include "Program.hpp"
+#include "Bytecode.hpp"
+#include <algorithm>
+
+namespace {
+
+const uint32_t INITIAL_SLOTS = 256;  // Power of two; kept under half full
+
+// FNV-1a
+uint32_t hashToken(std::string_view token) {
+    uint32_t h = 2166136261u;
+    for (char c : token) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    return h;
+}
+
+}  // namespace
+
+Program::Program() {
+    clear();
+}
+
+void Program::clear() {
+    addrs.clear();
+    token_begin.assign(1, 0);
+    tokens.clear();
+    code_begin.assign(1, 0);
+    code_bytes.clear();
+    token_text.clear();
+    token_start.assign(1, 0);
+    slots.assign(INITIAL_SLOTS, 0);
+}
+
+// Sizes the buffers for a program of known extent (LOAD) so appending it does not reallocate
+void Program::reserve(size_t lines, size_t text_bytes) {
+    addrs.reserve(lines);
+    token_begin.reserve(lines + 1);
+    code_begin.reserve(lines + 1);
+    tokens.reserve(text_bytes / 2);    // At most one token per character and its space
+    code_bytes.reserve(text_bytes);    // Bytecode is no longer than its source, plus a few bytes per line
+}
+
+void Program::append(uint32_t addr, std::string_view line) {
+    addrs.push_back(addr);
+    for (size_t start = 0;;) {
+        size_t space = line.find(' ', start);
+        tokens.push_back(intern(line.substr(start, space == std::string_view::npos ? std::string_view::npos : space - start)));
+        if (space == std::string_view::npos) break;
+        start = space + 1;
+    }
+    token_begin.push_back(static_cast<uint32_t>(tokens.size()));
+    Bytecode::assemble(line, code_bytes);
+    code_begin.push_back(static_cast<uint32_t>(code_bytes.size()));
+}
+
+void Program::appendLine(size_t i, std::string& out) const {
+    for (uint32_t t = token_begin[i]; t < token_begin[i + 1]; t++) {
+        if (t != token_begin[i]) out += ' ';
+        out += token(tokens[t]);
+    }
+}
+
+std::string Program::line(size_t i) const {
+    std::string out;
+    appendLine(i, out);
+    return out;
+}
+
+uint32_t Program::end(uint32_t start) const {
+    uint32_t end = start;
+    for (size_t i = 0; i < size(); i++) end = std::max(end, addrs[i] + codeLength(i));
+    return end;
+}
+
+std::string_view Program::token(uint32_t id) const {
+    return std::string_view(token_text).substr(token_start[id], token_start[id + 1] - token_start[id]);
+}
+
+// Id of token, adding it the first time it is seen
+uint32_t Program::intern(std::string_view text) {
+    uint32_t mask = static_cast<uint32_t>(slots.size()) - 1;
+    for (uint32_t slot = hashToken(text) & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot] == 0) break;
+        if (token(slots[slot] - 1) == text) return slots[slot] - 1;
+    }
+    uint32_t id = static_cast<uint32_t>(token_start.size()) - 1;
+    token_text.append(text);
+    token_start.push_back(static_cast<uint32_t>(token_text.size()));
+    if (2 * (id + 1) > slots.size()) grow();
+    else place(id);
+    return id;
+}
+
+// Puts id in the first free slot along its probe sequence
+void Program::place(uint32_t id) {
+    uint32_t mask = static_cast<uint32_t>(slots.size()) - 1;
+    uint32_t slot = hashToken(token(id)) & mask;
+    while (slots[slot] != 0) slot = (slot + 1) & mask;
+    slots[slot] = id + 1;
+}
+
+// Doubles the hash table and re-places every token
+void Program::grow() {
+    slots.assign(slots.size() * 2, 0);
+    for (uint32_t id = 0; id + 1 < token_start.size(); id++) place(id);
+}
@@ -0,0 +1,140 @@
+#include "RunControl.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Full-width registers, in the order they are published; the rest are views of these
+const Reg PUBLISHED_REGS[] = {
+    Reg::EAX, Reg::ECX, Reg::EDX, Reg::EBX, Reg::ESP, Reg::EBP, Reg::ESI, Reg::EDI,
+    Reg::ES, Reg::CS, Reg::SS, Reg::DS, Reg::EIP, Reg::FLAGS
+};
+
+}  // namespace
+
+constexpr std::chrono::microseconds RunControl::SLICE;
+constexpr std::chrono::milliseconds RunControl::PUBLISH_INTERVAL;
+
+RunControl::RunControl()
+    : state(State::Running), steps(0), attention_(false), memory_rows(0), sequence(0) {
+    static_assert(sizeof(PUBLISHED_REGS) / sizeof(PUBLISHED_REGS[0]) == REG_WORDS, "REG_WORDS must match");
+    for (auto& word : words) word.store(0, std::memory_order_relaxed);
+}
+
+// Prepares for a new RUN; called before the worker thread is started
+void RunControl::start(bool paused, uint32_t rows) {
+    std::lock_guard<std::mutex> lock(mutex);
+    state = paused ? State::Paused : State::Running;
+    steps = 0;
+    attention_.store(paused, std::memory_order_relaxed);
+    memory_rows = std::min(rows, uint32_t(MAX_MEMORY_ROWS));
+    last_publish = std::chrono::steady_clock::time_point();
+    sequence.store(0, std::memory_order_relaxed);
+}
+
+void RunControl::pause() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state != State::Running) return;
+    state = State::Paused;
+    attention_.store(true, std::memory_order_relaxed);
+    wake.notify_one();
+}
+
+void RunControl::resume() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state != State::Paused) return;
+    state = State::Running;
+    steps = 0;
+    attention_.store(false, std::memory_order_relaxed);
+    wake.notify_one();
+}
+
+void RunControl::step() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state == State::Stopping) return;
+    state = State::Paused;
+    steps++;
+    attention_.store(true, std::memory_order_relaxed);
+    wake.notify_one();
+}
+
+void RunControl::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    state = State::Stopping;
+    attention_.store(true, std::memory_order_relaxed);
+    wake.notify_one();
+}
+
+bool RunControl::paused() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state == State::Paused;
+}
+
+// Called by cmdRun when attention() is set: blocks until there is something to do
+RunControl::Action RunControl::proceed() {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return state != State::Paused || steps > 0; });
+    if (state == State::Stopping) return Action::Stop;
+    if (state == State::Running) return Action::Continue;
+    steps--;
+    return Action::Step;
+}
+
+void RunControl::pace(std::chrono::microseconds delay) {
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait_for(lock, delay, [this] { return state != State::Running; });
+}
+
+// Writes the state the UI shows; unless forced, at most once per PUBLISH_INTERVAL
+void RunControl::publish(const Registers& regs, const Memory& mem, uint32_t memory_addr, uint64_t retired, bool force) {
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - last_publish < PUBLISH_INTERVAL) return;
+    last_publish = now;
+
+    uint8_t stack[STACK_BYTES];
+    uint8_t memory[MAX_MEMORY_ROWS * 16];
+    uint32_t esp = regs.get(Reg::ESP);
+    mem.readBytes(esp, stack, sizeof(stack));
+    for (uint32_t row = 0; row < memory_rows; row++) {
+        mem.readBytes(memory_addr + row * 16, memory + row * 16, 16);  // Row by row: the window may wrap
+    }
+
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < REG_WORDS; i++) words[i].store(regs.get(PUBLISHED_REGS[i]), std::memory_order_relaxed);
+    words[ADDR_WORD].store(memory_addr, std::memory_order_relaxed);
+    for (size_t i = 0; i < STACK_BYTES / 4; i++) {
+        uint32_t word;
+        std::memcpy(&word, stack + i * 4, 4);
+        words[STACK_WORD + i].store(word, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < memory_rows * 4; i++) {
+        uint32_t word;
+        std::memcpy(&word, memory + i * 4, 4);
+        words[MEMORY_WORD + i].store(word, std::memory_order_relaxed);
+    }
+    words[RETIRED_WORD].store(static_cast<uint32_t>(retired), std::memory_order_relaxed);
+    words[RETIRED_WORD + 1].store(static_cast<uint32_t>(retired >> 32), std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+}
+
+// Copies the last published state; retries while a publish is in progress or overlapped the copy
+bool RunControl::sample(Frame& frame) const {
+    uint32_t copy[WORD_COUNT];
+    while (true) {
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if (before == 0) return false;
+        if (before & 1) continue;
+        for (size_t i = 0; i < WORD_COUNT; i++) copy[i] = words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) break;
+    }
+
+    for (size_t i = 0; i < REG_WORDS; i++) frame.regs.set(PUBLISHED_REGS[i], copy[i]);
+    frame.memory_addr = copy[ADDR_WORD];
+    std::memcpy(frame.stack, copy + STACK_WORD, STACK_BYTES);
+    std::memcpy(frame.memory, copy + MEMORY_WORD, sizeof(frame.memory));
+    frame.retired = copy[RETIRED_WORD] | (static_cast<uint64_t>(copy[RETIRED_WORD + 1]) << 32);
+    return true;
+}
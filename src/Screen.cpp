@@ -3,10 +3,12 @@
 #include <iomanip>    // For hex formatting (setw, setfill)
 #include <map>        // For std::map (register and memory maps)
 #include <cstring>    // For strlen and snprintf
+#include <algorithm>  // For std::max
+#include <utility>    // For std::move
 
 // Constructor for Screen class
 // Initializes the ncurses terminal interface and creates windows
-Screen::Screen() {
+Screen::Screen() : history_scroll(0) {
     initscr();  // Initialize ncurses screen
     start_color();  // Enable color support
     // Define color pairs: foreground/background
@@ -26,6 +28,8 @@ Screen::Screen() {
     initWindow(memory_win, max_y - 22, max_x / 2, 17, 0, 3, "Memory");     // Left bottom: memory view
     initWindow(history_win, max_y - 22, max_x / 2, 17, max_x / 2, 3, "History");  // Right bottom: command history
     initWindow(status_rect_win, 5, max_x, max_y - 5, 0, 3, "Status");      // Bottom: status messages
+    keypad(input_win, TRUE);  // Keys are read from the input pane; PgUp/PgDn arrive as single codes
+    present();
 }
 
 // Destructor for Screen class
@@ -41,14 +45,40 @@ void Screen::initWindow(WINDOW*& win, int height, int width, int start_y, int st
     wbkgd(win, COLOR_PAIR(color_pair));  // Set background color
     box(win, 0, 0);  // Draw a border around the window
     mvwprintw(win, 0, 1, "%s", title.c_str());  // Print title at top-left inside border
-    wrefresh(win);  // Refresh to display changes
+    wnoutrefresh(win);  // Staged; shown by present()
+}
+
+// Records now as what a pane shows; false if it already showed exactly that
+bool Screen::changed(std::string& shown, std::string now) {
+    if (now == shown) return false;
+    shown = std::move(now);
+    return true;
+}
+
+// Blanks a pane and redraws its frame
+// werase rather than wclear: wclear would make the next refresh repaint every cell
+void Screen::clearPane(WINDOW* win, const char* title) {
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 0, 1, "%s", title);
+}
+
+// Sends every pane staged since the last frame to the terminal in one update
+// The input pane is staged last so the cursor is left on the input line
+void Screen::present() {
+    wnoutrefresh(input_win);
+    doupdate();
 }
 
 // Updates the register window with current register values
-void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const std::string& changed_reg) {
-    wclear(reg_win);  // Clear the register window
-    box(reg_win, 0, 0);  // Redraw border
-    mvwprintw(reg_win, 0, 1, "Registers");  // Redraw title
+void Screen::updateRegisters(const Registers& regs, const std::string& changed_reg) {
+    std::string now = changed_reg;
+    for (int i = 0; i < static_cast<int>(Reg::COUNT); i++) {
+        uint32_t val = regs.get(static_cast<Reg>(i));
+        now.append(reinterpret_cast<const char*>(&val), sizeof(val));
+    }
+    if (!changed(reg_shown, std::move(now))) return;
+    clearPane(reg_win, "Registers");
 
     int x = 1, y = 1;  // Starting position inside window
     mvwprintw(reg_win, y++, x, "32-bit:");  // Section header for 32-bit registers
@@ -56,7 +86,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display 32-bit registers (EAX, EBX, ECX, EDX)
     for (const auto& reg : {"EAX", "EBX", "ECX", "EDX"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << regs.at(reg);  // Format value as 8-digit hex
+        val_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << regs.get(reg);  // Format value as 8-digit hex
         if (reg == changed_reg) {  // Highlight if this register changed
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));  // Bold yellow
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -70,7 +100,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display 32-bit registers (ESI, EDI, ESP, EBP)
     for (const auto& reg : {"ESI", "EDI", "ESP", "EBP"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << regs.at(reg);
+        val_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << regs.get(reg);
         if (reg == changed_reg) {
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -86,7 +116,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display 16-bit registers (AX, BX, CX, DX, SI)
     for (const auto& reg : {"AX", "BX", "CX", "DX", "SI"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << regs.at(reg);  // 4-digit hex
+        val_str << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << regs.get(reg);  // 4-digit hex
         if (reg == changed_reg) {
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -100,7 +130,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display 16-bit registers (DI, SP, BP)
     for (const auto& reg : {"DI", "SP", "BP"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << regs.at(reg);
+        val_str << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << regs.get(reg);
         if (reg == changed_reg) {
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -116,7 +146,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display 8-bit registers (AH, AL, BH, BL, CH, CL, DH, DL)
     for (const auto& reg : {"AH", "AL", "BH", "BL", "CH", "CL", "DH", "DL"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << regs.at(reg);  // 2-digit hex
+        val_str << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << regs.get(reg);  // 2-digit hex
         if (reg == changed_reg) {
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -132,7 +162,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display segment registers (CS, DS, SS, ES)
     for (const auto& reg : {"CS", "DS", "SS", "ES"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << regs.at(reg);
+        val_str << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << regs.get(reg);
         if (reg == changed_reg) {
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -146,7 +176,7 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
     // Display special registers (EIP, IP, FLAGS)
     for (const auto& reg : {"EIP", "IP", "FLAGS"}) {
         std::stringstream val_str;
-        val_str << std::hex << std::uppercase << (reg[0] == 'E' ? std::setw(8) : std::setw(4)) << std::setfill('0') << regs.at(reg);
+        val_str << std::hex << std::uppercase << (reg[0] == 'E' ? std::setw(8) : std::setw(4)) << std::setfill('0') << regs.get(reg);
         if (reg == changed_reg) {
             wattron(reg_win, A_BOLD | COLOR_PAIR(2));
             mvwprintw(reg_win, y, x, "%s: %s", reg, val_str.str().c_str());
@@ -157,22 +187,30 @@ void Screen::updateRegisters(const std::map<std::string, uint32_t>& regs, const
         x += (reg[0] == 'E' ? 14 : 10);  // Wider spacing for 32-bit EIP
     }
 
-    wrefresh(reg_win);  // Refresh to display updates
+    wnoutrefresh(reg_win);
 }
 
 // Updates the stack window with values around the ESP address
 void Screen::updateStack(const Memory& mem, uint32_t esp) {
-    wclear(stack_win);  // Clear the stack window
-    box(stack_win, 0, 0);  // Redraw border
-    mvwprintw(stack_win, 0, 1, "Stack (ESP)");  // Redraw title
+    // Up to 10 32-bit values starting at ESP, copied from the stack buffer in one go
+    uint8_t bytes[40];
+    mem.readBytes(esp, bytes, sizeof(bytes));
+    updateStack(esp, bytes);
+}
+
+void Screen::updateStack(uint32_t esp, const uint8_t* bytes) {
+    std::string now(reinterpret_cast<const char*>(&esp), sizeof(esp));
+    now.append(reinterpret_cast<const char*>(bytes), 40);
+    if (!changed(stack_shown, std::move(now))) return;
+    clearPane(stack_win, "Stack (ESP)");
 
     int y = 1;
     mvwprintw(stack_win, y++, 1, "Top:");  // Label for stack top
     int max_y = getmaxy(stack_win) - 1;  // Prevent overflow
-    // Display up to 10 32-bit values starting at ESP
     for (int i = 0; i < 10 && y < max_y; i++) {
         uint32_t addr = esp + (i * 4);  // Increment by 4 bytes (stack grows upward here for display)
-        uint32_t val = mem.read(addr);  // Read 32-bit value from memory
+        const uint8_t* b = bytes + i * 4;
+        uint32_t val = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
 
         std::stringstream addr_str;
         addr_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << addr;
@@ -186,95 +224,127 @@ void Screen::updateStack(const Memory& mem, uint32_t esp) {
             mvwprintw(stack_win, y++, 1, "%s: %s", addr_str.str().c_str(), val_str.str().c_str());
         }
     }
-    wrefresh(stack_win);  // Refresh to display updates
+    wnoutrefresh(stack_win);
+}
+
+// Number of 16-byte rows the memory pane shows
+int Screen::memoryRows() const {
+    return std::max(getmaxy(memory_win) - 2, 0);
 }
 
 // Updates the memory and history windows
-void Screen::updateMemoryAndHistory(const std::map<uint32_t, uint8_t>& mem, uint32_t start_addr, const std::vector<std::pair<uint32_t, std::string>>& history) {
-    // Memory section
-    wclear(memory_win);  // Clear the memory window
-    box(memory_win, 0, 0);  // Redraw border
-    mvwprintw(memory_win, 0, 1, "Memory");  // Redraw title
+void Screen::updateMemoryAndHistory(const Memory& mem, uint32_t start_addr, const CommandLog& log) {
+    // Memory section: 16-byte rows starting at start_addr, copied first to see if any changed
+    std::vector<uint8_t> bytes(memoryRows() * 16);
+    for (size_t i = 0; i < bytes.size(); i += 16) mem.readBytes(start_addr + i, &bytes[i], 16);
+    updateMemory(start_addr, bytes.data());
+    updateHistory(log);
+}
 
-    int y = 1;
-    int max_y = getmaxy(memory_win) - 1;  // Prevent overflow
+void Screen::updateMemory(uint32_t start_addr, const uint8_t* bytes) {
     int max_x = getmaxx(memory_win);  // Window width for truncation
-    // Display memory in 16-byte rows starting at start_addr
-    for (int i = 0; i < max_y - 1; i++) {
-        uint32_t addr = start_addr + (i * 16);  // Each row increments by 16 bytes
-        std::stringstream addr_str;
-        addr_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << addr;
-        std::stringstream hex_str;
-        std::stringstream ascii_str;
-        // Build hex and ASCII representation for 16 bytes
-        for (int j = 0; j < 16; j++) {
-            uint32_t byte_addr = addr + j;  // Address of each byte
-            auto it = mem.find(byte_addr);
-            uint8_t byte = (it != mem.end()) ? it->second : 0;  // Get byte or 0 if not present
-            hex_str << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
-            if (j < 15) hex_str << " ";  // Space between bytes except last
-            ascii_str << (byte >= 32 && byte <= 126 ? static_cast<char>(byte) : '.');  // Printable or dot
-        }
-        std::string line = addr_str.str() + ": " + hex_str.str() + "  " + ascii_str.str();
-        if (line.length() > static_cast<size_t>(max_x - 2)) {  // Truncate if too long
-            line = line.substr(0, max_x - 2);
+    int rows = memoryRows();
+    std::string now(reinterpret_cast<const char*>(&start_addr), sizeof(start_addr));
+    now.append(reinterpret_cast<const char*>(bytes), rows * 16);
+    if (changed(memory_shown, std::move(now))) {
+        clearPane(memory_win, "Memory");
+        bytes = reinterpret_cast<const uint8_t*>(memory_shown.data() + sizeof(start_addr));
+        int y = 1;
+        for (int i = 0; i < rows; i++) {
+            uint32_t addr = start_addr + (i * 16);  // Each row increments by 16 bytes
+            const uint8_t* row = bytes + i * 16;
+            std::stringstream addr_str;
+            addr_str << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << addr;
+            std::stringstream hex_str;
+            std::stringstream ascii_str;
+            // Build hex and ASCII representation for 16 bytes
+            for (int j = 0; j < 16; j++) {
+                uint8_t byte = row[j];  // Untouched pages read as 0
+                hex_str << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+                if (j < 15) hex_str << " ";  // Space between bytes except last
+                ascii_str << (byte >= 32 && byte <= 126 ? static_cast<char>(byte) : '.');  // Printable or dot
+            }
+            std::string line = addr_str.str() + ": " + hex_str.str() + "  " + ascii_str.str();
+            if (line.length() > static_cast<size_t>(max_x - 2)) {  // Truncate if too long
+                line = line.substr(0, max_x - 2);
+            }
+            mvwprintw(memory_win, y++, 1, "%s", line.c_str());
         }
-        mvwprintw(memory_win, y++, 1, "%s", line.c_str());
+        wnoutrefresh(memory_win);
     }
-    wrefresh(memory_win);  // Refresh to display updates
+}
 
-    // History section
-    wclear(history_win);  // Clear the history window
-    box(history_win, 0, 0);  // Redraw border
-    mvwprintw(history_win, 0, 1, "History");  // Redraw title
-    y = 1;
-    // Display history in reverse order (most recent first)
-    for (int i = history.size() - 1; i >= 0 && y < getmaxy(history_win) - 1; i--) {
-        char line[256];
-        snprintf(line, sizeof(line), "%08X: %s", history[i].first, history[i].second.c_str());  // Address: Command
-        if (strlen(line) > static_cast<size_t>(getmaxx(history_win) - 2)) {  // Truncate if too long
-            line[getmaxx(history_win) - 2] = '\0';
-        }
-        mvwprintw(history_win, y++, 1, "%s", line);
+// History pane: the log from history_scroll lines back, most recent first
+// Only the rows that fit are formatted, and only when the log or the scroll position moved
+void Screen::updateHistory(const CommandLog& log) {
+    size_t rows = std::max(getmaxy(history_win) - 2, 0);
+    history_scroll = std::min(history_scroll, log.size() > rows ? log.size() - rows : 0);
+    char key[64];
+    snprintf(key, sizeof(key), "%llu %zu %zu", static_cast<unsigned long long>(log.pushed()), log.size(), history_scroll);
+    if (!changed(history_shown, key)) return;
+
+    char title[48];
+    if (history_scroll) snprintf(title, sizeof(title), "History (-%zu, PgDn)", history_scroll);
+    else snprintf(title, sizeof(title), "History");
+    clearPane(history_win, title);
+    int width = std::max(getmaxx(history_win) - 2, 0);
+    for (size_t y = 0; y < rows && history_scroll + y < log.size(); y++) {
+        const CommandLog::Entry& entry = log.recent(history_scroll + y);
+        char line[80];
+        int len = snprintf(line, sizeof(line), "%08X: %.*s", entry.addr, static_cast<int>(entry.length), entry.text);  // Address: Command
+        mvwprintw(history_win, static_cast<int>(y) + 1, 1, "%.*s", std::min(len, width), line);
     }
-    wrefresh(history_win);  // Refresh to display updates
+    wnoutrefresh(history_win);
+}
+
+// Moves the History pane a page towards older (PgUp) or newer (PgDn) lines; updateHistory clamps it
+void Screen::scrollHistory(bool older) {
+    size_t page = std::max(getmaxy(history_win) - 2, 1);
+    if (older) history_scroll += page;
+    else history_scroll -= std::min(history_scroll, page);
 }
 
 // Updates the status window with a message
 void Screen::updateStatus(const std::string& msg) {
-    wclear(status_rect_win);  // Clear the status window
-    box(status_rect_win, 0, 0);  // Redraw border
-    mvwprintw(status_rect_win, 0, 1, "Status");  // Redraw title
+    if (!changed(status_shown, msg)) return;
+    clearPane(status_rect_win, "Status");
     mvwprintw(status_rect_win, 1, 1, "%s", msg.c_str());  // Display status message
-    wrefresh(status_rect_win);  // Refresh to display updates
+    wnoutrefresh(status_rect_win);
 }
 
-// Retrieves user input from the input window
-std::string Screen::getInput() {
-    wclear(input_win);  // Clear the input window
-    box(input_win, 0, 0);  // Redraw border
-    mvwprintw(input_win, 0, 1, "Input");  // Redraw title
+// Clears the input line and shows the prompt
+void Screen::promptInput() {
+    clearPane(input_win, "Input");
     mvwprintw(input_win, 1, 1, "> ");  // Prompt
     wmove(input_win, 1, 3);  // Move cursor after prompt
     wrefresh(input_win);  // Refresh to show prompt
+}
 
-    std::string input;  // Store user input
-    int ch, pos = 3;  // Current character and cursor position
-    while ((ch = wgetch(input_win)) != '\n') {  // Read characters until Enter
-        if (ch == KEY_BACKSPACE || ch == 127) {  // Handle backspace
-            if (!input.empty()) {
-                input.pop_back();  // Remove last character
-                pos--;
-                wmove(input_win, 1, pos);
-                waddch(input_win, ' ');  // Overwrite with space
-                wmove(input_win, 1, pos);  // Move cursor back
-            }
-        } else if (ch >= 32 && ch <= 126) {  // Printable ASCII characters
-            input += static_cast<char>(ch);  // Add to input string
-            waddch(input_win, ch);  // Display character
-            pos++;
+// Waits up to timeout_ms (-1: forever) for a key and applies it to line, which is kept between calls
+// Returns true on Enter, leaving the completed line for the caller
+// Waiting blocks in wgetch, so an idle session costs nothing; only the input line is refreshed per key
+bool Screen::readInput(std::string& line, int timeout_ms) {
+    wtimeout(input_win, timeout_ms);
+    int ch = wgetch(input_win);
+    if (ch == ERR) return false;  // Timed out
+    if (ch == '\n' || ch == KEY_ENTER) return true;
+    if (ch == KEY_PPAGE || ch == KEY_NPAGE) {  // Scrolls the History pane; the caller redraws it
+        scrollHistory(ch == KEY_PPAGE);
+        return false;
+    }
+    int pos = 3 + static_cast<int>(line.size());  // Cursor position after the prompt
+    if (ch == KEY_BACKSPACE || ch == 127) {  // Handle backspace
+        if (!line.empty()) {
+            line.pop_back();  // Remove last character
+            pos--;
+            wmove(input_win, 1, pos);
+            waddch(input_win, ' ');  // Overwrite with space
+            wmove(input_win, 1, pos);  // Move cursor back
         }
-        wrefresh(input_win);  // Refresh after each change
+    } else if (ch >= 32 && ch <= 126) {  // Printable ASCII characters
+        line += static_cast<char>(ch);  // Add to input string
+        waddch(input_win, ch);  // Display character
     }
-    return input;  // Return the completed input string
+    wrefresh(input_win);  // Refresh after each change
+    return false;
 }
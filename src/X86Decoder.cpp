@@ -0,0 +1,239 @@
+#include "X86Decoder.hpp"
+
+namespace {
+
+// Reads instruction bytes in order, counting how many were used
+struct Cursor {
+    const uint8_t* bytes;
+    uint32_t pos;
+
+    uint8_t u8() { return bytes[pos++]; }
+    uint32_t s8() { return static_cast<uint32_t>(static_cast<int8_t>(u8())); }  // Sign-extended
+    uint32_t u16() {
+        uint32_t v = bytes[pos] | (bytes[pos + 1] << 8);
+        pos += 2;
+        return v;
+    }
+    uint32_t u32() {
+        uint32_t v = bytes[pos] | (bytes[pos + 1] << 8) | (bytes[pos + 2] << 16) | (static_cast<uint32_t>(bytes[pos + 3]) << 24);
+        pos += 4;
+        return v;
+    }
+};
+
+// Jcc condition codes 0-F; the overflow, sign and parity tests have no Cond
+const Opcode JCC[16] = {
+    Opcode::Invalid, Opcode::Invalid, Opcode::Jb, Opcode::Jae, Opcode::Je, Opcode::Jne, Opcode::Jbe, Opcode::Ja,
+    Opcode::Invalid, Opcode::Invalid, Opcode::Invalid, Opcode::Invalid, Opcode::Jl, Opcode::Jge, Opcode::Jle, Opcode::Jg
+};
+
+// Arithmetic group member (the opcode bits 5:3, or the ModRM reg field of 80/81/83)
+Opcode aluOpcode(uint8_t n) {
+    switch (n) {
+        case 0: return Opcode::Add;
+        case 5: return Opcode::Sub;
+        case 6: return Opcode::Xor;
+        case 7: return Opcode::Cmp;
+        default: return Opcode::Invalid;  // OR, ADC, SBB, AND
+    }
+}
+
+// Register n of the ModRM/opcode encoding, as a 32-bit or 8-bit register
+Operand reg(uint8_t n, bool byte) {
+    Operand op;
+    op.kind = OperandKind::Reg;
+    op.reg = static_cast<Reg>(n + (byte ? static_cast<uint8_t>(Reg::AL) : 0));  // Same order as the encoding
+    return op;
+}
+
+Operand imm(uint32_t value) {
+    Operand op;
+    op.kind = OperandKind::Imm;
+    op.value = value;
+    return op;
+}
+
+Operand absolute(uint32_t addr) {
+    Operand op;
+    op.kind = OperandKind::Mem;
+    op.value = addr;
+    return op;
+}
+
+// Decodes a ModRM byte, and any SIB byte and displacement after it, into the
+// r/m operand; returns the reg field
+uint8_t modrm(Cursor& c, bool byte, Operand& rm) {
+    uint8_t b = c.u8();
+    uint8_t mod = b >> 6;
+    uint8_t field = (b >> 3) & 7;
+    uint8_t low = b & 7;
+    if (mod == 3) {
+        rm = reg(low, byte);
+        return field;
+    }
+    rm = Operand();
+    rm.kind = OperandKind::Mem;
+    if (low == 4) {
+        uint8_t sib = c.u8();
+        uint8_t index = (sib >> 3) & 7;
+        uint8_t base = sib & 7;
+        rm.scale = 1 << (sib >> 6);
+        if (index != 4) rm.index = static_cast<Reg>(index);  // ESP cannot be an index: 4 means none
+        if (base == 5 && mod == 0) rm.value = c.u32();
+        else rm.reg = static_cast<Reg>(base);
+    } else if (low == 5 && mod == 0) {
+        rm.value = c.u32();  // disp32 alone
+    } else {
+        rm.reg = static_cast<Reg>(low);
+    }
+    if (mod == 1) rm.value += c.s8();
+    else if (mod == 2) rm.value += c.u32();
+    return field;
+}
+
+}  // namespace
+
+// Decodes the instruction at addr, setting its length
+// Relative branch targets are resolved to absolute addresses here
+Instruction X86Decoder::decode(const Memory& mem, uint32_t addr) {
+    uint8_t bytes[MAX_LENGTH];
+    mem.readBytes(addr, bytes, sizeof(bytes));
+    Cursor c{bytes, 0};
+
+    Instruction insn;
+    Instruction invalid;
+    invalid.op = Opcode::Invalid;
+    invalid.length = 1;
+
+    uint8_t op = c.u8();
+    if (op < 0x40 && (op & 7) < 6) {
+        // 00-3D arithmetic: r/m,r  r/m,r  r,r/m  r,r/m  AL,imm8  EAX,imm32 (even opcodes are 8-bit)
+        insn.op = aluOpcode(op >> 3);
+        if (insn.op == Opcode::Invalid) return invalid;
+        insn.width = (op & 1) == 0 ? Width::Byte : Width::Dword;
+        switch (op & 7) {
+            case 0: case 1: insn.src = reg(modrm(c, insn.byte(), insn.dst), insn.byte()); break;
+            case 2: case 3: insn.dst = reg(modrm(c, insn.byte(), insn.src), insn.byte()); break;
+            case 4: insn.dst = reg(0, true); insn.src = imm(c.u8()); break;
+            default: insn.dst = reg(0, false); insn.src = imm(c.u32()); break;
+        }
+    } else if (op >= 0x40 && op <= 0x4F) {
+        insn.op = op < 0x48 ? Opcode::Inc : Opcode::Dec;
+        insn.dst = reg(op & 7, false);
+    } else if (op >= 0x50 && op <= 0x5F) {
+        insn.op = op < 0x58 ? Opcode::Push : Opcode::Pop;
+        insn.dst = reg(op & 7, false);
+    } else if (op >= 0x70 && op <= 0x7F) {
+        insn.op = JCC[op & 0xF];
+        if (insn.op == Opcode::Invalid) return invalid;
+        uint32_t rel = c.s8();
+        insn.dst = imm(addr + c.pos + rel);
+    } else if (op >= 0x88 && op <= 0x8B) {
+        insn.op = Opcode::Mov;
+        insn.width = (op & 1) == 0 ? Width::Byte : Width::Dword;
+        if (op < 0x8A) insn.src = reg(modrm(c, insn.byte(), insn.dst), insn.byte());
+        else insn.dst = reg(modrm(c, insn.byte(), insn.src), insn.byte());
+    } else if (op >= 0xA0 && op <= 0xA3) {
+        // MOV AL/EAX <-> [moffs32]
+        insn.op = Opcode::Mov;
+        insn.width = (op & 1) == 0 ? Width::Byte : Width::Dword;
+        if (op < 0xA2) {
+            insn.dst = reg(0, insn.byte());
+            insn.src = absolute(c.u32());
+        } else {
+            insn.dst = absolute(c.u32());
+            insn.src = reg(0, insn.byte());
+        }
+    } else if (op >= 0xB0 && op <= 0xBF) {
+        insn.op = Opcode::Mov;
+        insn.width = op < 0xB8 ? Width::Byte : Width::Dword;
+        insn.dst = reg(op & 7, insn.byte());
+        insn.src = imm(insn.byte() ? c.u8() : c.u32());
+    } else {
+        switch (op) {
+            case 0x0F: {
+                uint8_t op2 = c.u8();
+                if (op2 < 0x80 || op2 > 0x8F) return invalid;
+                insn.op = JCC[op2 & 0xF];
+                if (insn.op == Opcode::Invalid) return invalid;
+                uint32_t rel = c.u32();
+                insn.dst = imm(addr + c.pos + rel);
+                break;
+            }
+            case 0x68:
+                insn.op = Opcode::Push;
+                insn.dst = imm(c.u32());
+                break;
+            case 0x6A:
+                insn.op = Opcode::Push;
+                insn.dst = imm(c.s8());
+                break;
+            case 0x80:
+            case 0x81:
+            case 0x83:
+                insn.width = op == 0x80 ? Width::Byte : Width::Dword;
+                insn.op = aluOpcode(modrm(c, insn.byte(), insn.dst));
+                if (insn.op == Opcode::Invalid) return invalid;
+                insn.src = imm(op == 0x81 ? c.u32() : c.s8());
+                break;
+            case 0x8F:
+                insn.op = Opcode::Pop;
+                if (modrm(c, false, insn.dst) != 0) return invalid;
+                break;
+            case 0x90:
+                insn.op = Opcode::Nop;
+                break;
+            case 0xC2:
+                insn.op = Opcode::Ret;
+                insn.src = imm(c.u16());
+                break;
+            case 0xC3:
+                insn.op = Opcode::Ret;
+                insn.src = imm(0);
+                break;
+            case 0xC6:
+            case 0xC7:
+                insn.op = Opcode::Mov;
+                insn.width = op == 0xC6 ? Width::Byte : Width::Dword;
+                if (modrm(c, insn.byte(), insn.dst) != 0) return invalid;
+                insn.src = imm(insn.byte() ? c.u8() : c.u32());
+                break;
+            case 0xE8:
+            case 0xE9: {
+                insn.op = op == 0xE8 ? Opcode::Call : Opcode::Jmp;
+                uint32_t rel = c.u32();
+                insn.dst = imm(addr + c.pos + rel);
+                break;
+            }
+            case 0xEB: {
+                insn.op = Opcode::Jmp;
+                uint32_t rel = c.s8();
+                insn.dst = imm(addr + c.pos + rel);
+                break;
+            }
+            case 0xF4:
+                insn.op = Opcode::Hlt;
+                break;
+            case 0xFE:
+            case 0xFF: {
+                // Group 4/5: INC, DEC, and for 32-bit operands CALL, JMP and PUSH r/m
+                insn.width = op == 0xFE ? Width::Byte : Width::Dword;
+                uint8_t field = modrm(c, insn.byte(), insn.dst);
+                switch (field) {
+                    case 0: insn.op = Opcode::Inc; break;
+                    case 1: insn.op = Opcode::Dec; break;
+                    case 2: insn.op = Opcode::Call; break;
+                    case 4: insn.op = Opcode::Jmp; break;
+                    case 6: insn.op = Opcode::Push; break;
+                    default: return invalid;  // Far CALL/JMP
+                }
+                if (insn.byte() && field > 1) return invalid;
+                break;
+            }
+            default:
+                return invalid;
+        }
+    }
+    insn.length = static_cast<uint16_t>(c.pos);
+    return insn;
+}
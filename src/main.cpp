@@ -1,13 +1,124 @@
 #include "Emulator.hpp"  // Include the Emulator class header
+#include <cstdio>        // For fprintf usage messages
+#include <cstdlib>       // For strtoul when parsing numeric options
+#include <cstring>       // For strcmp/strchr when parsing arguments
+#include <string>
+#include <utility>
+#include <vector>
+
+// Prints command-line usage to stderr
+static void usage() {
+    fprintf(stderr,
+            "Usage: emulator [--image file | --program file | --bin file [--base addr]] [--rate n] [--jit mode] [--opt mode]\n"
+            "       emulator [--image file] [--jit mode] [--opt mode] --batch program [--dump addr:len ...]\n"
+            "                [--profile n] [--folded file]\n"
+            "       emulator (--program file | --bin file [--base addr]) [--jit mode] [--opt mode] --run [--dump addr:len ...]\n"
+            "  --image file     start from a machine image written by SAVE\n"
+            "  --program file   start with an assembly source file loaded (labels, comments, .data/.org/.byte ...)\n"
+            "  --bin file       start with an IA-32 binary loaded (flat, or static ELF32)\n"
+            "  --base addr      where a flat --bin binary is placed (hex, default 1000)\n"
+            "  --rate n         RUN speed in instructions/second, 0 = unthrottled (default 1)\n"
+            "  --jit mode       off, on (compile hot blocks to native code) or check (compare with the interpreter)\n"
+            "  --opt mode       off, on (peephole-optimize decoded blocks) or dump (also print them to stderr)\n"
+            "  --batch program  run the program without the UI and print the final state\n"
+            "  --run            run the --program or --bin code without the UI and print the final state\n"
+            "  --dump addr:len  also print len bytes at addr (both hex) after a batch run\n"
+            "  --profile n      count executions per address and print the n hottest lines and loops after a batch run\n"
+            "  --folded file    profile, and write folded stacks for flamegraph tools to file after a batch run\n");
+}
 
 // Main function: Entry point of the CPU emulator program
-int main() {
+int main(int argc, char** argv) {
     Emulator emulator;  // Create an instance of the Emulator class
-                        // This initializes the CPU, registers, memory, and screen components
-    
+                        // This initializes the CPU, registers, and memory; the screen starts with run()
+
+    std::string batch_path;
+    std::string program_path;
+    std::string bin_path;
+    uint32_t bin_base = CPU::PROGRAM_BASE;
+    bool run_bin = false;
+    std::vector<std::pair<uint32_t, uint32_t>> dumps;
+    size_t profile_top = 0;
+    std::string folded_path;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            emulator.loadImage(argv[++i]);  // Start from a saved machine image instead of the empty state
+        } else if (std::strcmp(argv[i], "--program") == 0 && i + 1 < argc) {
+            program_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--bin") == 0 && i + 1 < argc) {
+            bin_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--base") == 0 && i + 1 < argc) {
+            bin_base = std::strtoul(argv[++i], nullptr, 16);
+        } else if (std::strcmp(argv[i], "--run") == 0) {
+            run_bin = true;
+        } else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            emulator.setRunRate(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--jit") == 0 && i + 1 < argc) {
+            JitMode mode;
+            if (!Jit::parseMode(argv[++i], mode)) {
+                usage();
+                return 2;
+            }
+            if (mode != JitMode::Off && !Jit::available()) {
+                fprintf(stderr, "emulator: --jit is not supported on this host; interpreting\n");
+            } else {
+                emulator.setJitMode(mode);
+            }
+        } else if (std::strcmp(argv[i], "--opt") == 0 && i + 1 < argc) {
+            OptMode mode;
+            if (!Optimizer::parseMode(argv[++i], mode)) {
+                usage();
+                return 2;
+            }
+            emulator.setOptMode(mode);
+        } else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_top = std::strtoul(argv[++i], nullptr, 10);
+            if (profile_top == 0) {
+                usage();
+                return 2;
+            }
+        } else if (std::strcmp(argv[i], "--folded") == 0 && i + 1 < argc) {
+            folded_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--dump") == 0 && i + 1 < argc && std::strchr(argv[i + 1], ':')) {
+            const char* spec = argv[++i];
+            uint32_t addr = std::strtoul(spec, nullptr, 16);
+            uint32_t len = std::strtoul(std::strchr(spec, ':') + 1, nullptr, 16);
+            dumps.push_back({addr, len});
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (profile_top || !folded_path.empty()) emulator.setProfile(profile_top, folded_path);
+    if (run_bin && bin_path.empty() && program_path.empty()) {
+        usage();
+        return 2;
+    }
+    if (!program_path.empty()) {
+        std::string status = emulator.loadProgram(program_path);
+        if (run_bin && status.rfind("LOAD failed", 0) == 0) {
+            fprintf(stderr, "emulator: %s\n", status.c_str());
+            return 1;
+        }
+    }
+    if (!bin_path.empty()) {
+        std::string status = emulator.loadBinary(bin_path, bin_base);  // After --base, wherever it appeared
+        if (run_bin && status.rfind("LOADBIN failed", 0) == 0) {
+            fprintf(stderr, "emulator: %s\n", status.c_str());
+            return 1;
+        }
+    }
+
+    if (!batch_path.empty() || run_bin) {
+        return emulator.runBatch(batch_path, dumps);  // Headless: no ncurses, no delays
+    }
+
     emulator.run();     // Start the emulator's main execution loop
                         // This handles user input, executes commands, and updates the UI until terminated
-    
+
     return 0;           // Exit the program with a success status (0)
                         // Reached when the emulator loop exits (e.g., via QUIT command)
 }
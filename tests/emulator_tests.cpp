@@ -0,0 +1,255 @@
+// Regression tests driven through the same entry points as the UI and batch mode
+// Usage: emulator_tests [name]  (every test without a name)
+#include "CPU.hpp"
+#include "Assembler.hpp"
+#include "Flags.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                               \
+    do {                                                                          \
+        if (!(cond)) {                                                            \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                           \
+        }                                                                         \
+    } while (0)
+
+// A fresh machine with RUN unthrottled, as in batch mode
+struct Machine {
+    Registers regs;
+    Memory mem;
+    CPU cpu{regs, mem};
+
+    Machine() { cpu.run_rate = 0; }
+    std::string execute(const std::string& line) { return cpu.execute(line, nullptr); }
+    bool load(const char* source) {
+        Assembler::Output out;
+        std::string error;
+        if (!Assembler::assemble(source, CPU::PROGRAM_BASE, out, error)) {
+            fprintf(stderr, "assembly failed: %s\n", error.c_str());
+            return false;
+        }
+        cpu.sourceLoaded(out);
+        return true;
+    }
+};
+
+// MOV FLAGS can set TF, IF and DF; a compiled block that reads FLAGS must not
+// load them into the host (TF alone would trap the process)
+void jit_masks_guest_flags() {
+    Machine m;
+    if (Jit::available()) m.cpu.setJitMode(JitMode::On);
+    CHECK(m.load(
+        "        MOV ECX #100\n"
+        "loop:   MOV FLAGS 700\n"       // TF IF DF, ZF clear
+        "        JNE check\n"
+        "check:  MOV EAX 1\n"           // Reads FLAGS before writing them: compiled once hot
+        "        JNE next\n"
+        "        MOV EAX 2\n"
+        "next:   SUB ECX 1\n"
+        "        JNE loop\n"));
+    CHECK(m.execute("RUN") == "RUN completed");
+    CHECK(m.regs.get(Reg::EAX) == 1);
+    CHECK(m.regs.get(Reg::ECX) == 0);
+}
+
+// A checkpoint taken by a CHECKPOINT line inside a RUN must not bring the RUN back on RESTORE
+void restore_checkpoint_taken_in_run() {
+    Machine m;
+    m.execute("MOV EAX 1");
+    m.execute("CHECKPOINT A");
+    m.execute("MOV EBX 2");
+    CHECK(m.execute("RUN") == "RUN completed");
+    CHECK(m.execute("RESTORE A") == "RESTORE A done");
+    CHECK(!m.cpu.is_running);
+    uint32_t eip = m.regs.get(Reg::EIP);
+    m.execute("MOV ECX 3");  // Still recorded: the emulator is not stuck in a RUN
+    CHECK(m.regs.get(Reg::EIP) > eip);
+    CHECK(m.execute("RUN") == "RUN completed");
+    CHECK(m.regs.get(Reg::ECX) == 3);
+}
+
+// Lines typed after loading a source are assembled past its last line and must not land on its data
+void append_after_source_with_data() {
+    Machine m;
+    CHECK(m.load(
+        "        MOV EAX 0\n"
+        "        MOV ESI table\n"
+        "        ADD EAX [ESI]\n"
+        "        ADD EAX [ESI+4]\n"
+        "        .data\n"
+        "table:  .dword 3, 4\n"));
+    for (int i = 0; i < 4; i++) m.execute("MOV EBX 7");
+    CHECK(m.mem.read(Assembler::DATA_BASE) == 3);
+    CHECK(m.mem.read(Assembler::DATA_BASE + 4) == 4);
+    CHECK(m.execute("RUN") == "RUN completed");
+    CHECK(m.regs.get(Reg::EAX) == 7);
+    CHECK(m.regs.get(Reg::EBX) == 7);
+}
+
+// An instruction line that does not parse is reported and never recorded, whatever its operands
+void bad_line_not_recorded() {
+    Machine m;
+    m.execute("MOV EAX 1");
+    uint32_t eip = m.regs.get(Reg::EIP);
+    const char* lines[] = {
+        "ADD [1000] ZZZ#", "SUB [ZZZ] EAX", "XOR EAX ZZZ#", "CMP EAX [ZZZ]", "ADD ZZZ 1",
+        "MOV EAX ZZZ#", "MOV [ZZ] EAX", "MOV ZZZ 1", "MOVB [1000] 100", "MOVB EAX [1000]",
+        "PUSH ZZZ", "PUSH 7", "POP ZZZ", "JNE ZZZ", "JE",
+    };
+    for (const char* line : lines) {
+        CHECK(m.execute(line).find(" failed: ") != std::string::npos);
+        CHECK(m.regs.get(Reg::EIP) == eip);
+    }
+    CHECK(m.execute("PUSH 7") == "PUSH failed: Invalid register (expected a register at column 6)");
+    CHECK(m.execute("POP  ZZZ") == "POP failed: Invalid register (expected a register at column 6)");
+    CHECK(m.execute("RUN") == "RUN completed");
+    CHECK(m.cpu.instructionCount() == 1);
+}
+
+// Operand pairs around the signed and unsigned boundaries
+const uint32_t COMPARE_VALUES[] = {0, 1, 2, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFE, 0xFFFFFFFF};
+const char* const JUMPS[] = {"JE", "JNE", "JG", "JL", "JGE", "JLE", "JA", "JB", "JAE", "JBE"};
+const Cond CONDS[] = {Cond::E, Cond::NE, Cond::G, Cond::L, Cond::GE, Cond::LE, Cond::A, Cond::B, Cond::AE, Cond::BE};
+
+// Whether cond holds for the FLAGS word CMP a b leaves, going through the flag bits
+bool flagsHold(Cond cond, uint32_t a, uint32_t b) {
+    LazyFlags cmp;
+    cmp.record(FlagOp::Sub, a, b, a - b);
+    LazyFlags word;
+    word.set(cmp.value());
+    return word.test(cond);
+}
+
+// compareHolds decides conditions for both LazyFlags::test after CMP and the
+// fused compare-and-branch; each must agree with the flag bits
+void compare_conditions() {
+    for (uint32_t a : COMPARE_VALUES) {
+        for (uint32_t b : COMPARE_VALUES) {
+            LazyFlags cmp;
+            cmp.record(FlagOp::Sub, a, b, a - b);
+            uint32_t expected = 0;  // One bit per jump not taken
+            std::string source = "        MOV EAX #" + std::to_string(a) + "\n        MOV EBX #" + std::to_string(b) + "\n";
+            for (size_t i = 0; i < sizeof(CONDS) / sizeof(CONDS[0]); i++) {
+                bool holds = flagsHold(CONDS[i], a, b);
+                CHECK(cmp.test(CONDS[i]) == holds);
+                CHECK(compareHolds(CONDS[i], a, b) == holds);
+                if (!holds) expected |= 1u << i;
+                std::string skip = "skip" + std::to_string(i);
+                source += "        CMP EAX EBX\n        " + std::string(JUMPS[i]) + " " + skip + "\n";
+                source += "        ADD ECX #" + std::to_string(1u << i) + "\n" + skip + ":\n";
+            }
+            for (OptMode mode : {OptMode::Off, OptMode::On}) {  // On fuses each CMP with its jump
+                Machine m;
+                m.cpu.setOptMode(mode);
+                CHECK(m.load(source.c_str()));
+                CHECK(m.execute("RUN") == "RUN completed");
+                CHECK(m.regs.get(Reg::ECX) == expected);
+            }
+        }
+    }
+}
+
+// ADD/CMP on AL and AX take their flags at 8 and 16 bits, typed or in a RUN
+void sub_register_flags() {
+    const struct {
+        const char* set;
+        const char* op;
+        uint32_t flags;
+    } cases[] = {
+        {"MOV AL 0FF", "ADD AL 1", CPU::CF | CPU::PF | CPU::AF | CPU::ZF},  // Carry out of bit 7
+        {"MOV AL 7F", "ADD AL 1", CPU::AF | CPU::SF | CPU::OF},             // Signed overflow at 8 bits
+        {"MOV AL 80", "CMP AL 1", CPU::AF | CPU::OF},                       // -128 - 1
+        {"MOV AX 0FFFF", "ADD AX 1", CPU::CF | CPU::PF | CPU::AF | CPU::ZF},
+        {"MOV AX 7FFF", "ADD AX 1", CPU::PF | CPU::AF | CPU::SF | CPU::OF},
+        {"MOV AX 8000", "CMP AX 1", CPU::PF | CPU::AF | CPU::OF},
+    };
+    for (const auto& c : cases) {
+        Machine m;
+        m.execute(c.set);
+        m.execute(c.op);
+        CHECK(m.regs.get(Reg::FLAGS) == c.flags);
+        for (OptMode mode : {OptMode::Off, OptMode::On}) {
+            m.cpu.setOptMode(mode);
+            m.regs.set(Reg::FLAGS, 0);
+            CHECK(m.execute("RUN") == "RUN completed");
+            CHECK(m.regs.get(Reg::FLAGS) == c.flags);
+        }
+    }
+
+    // A signed jump after a byte compare: 80 is -128 in AL
+    for (OptMode mode : {OptMode::Off, OptMode::On}) {
+        Machine m;
+        m.cpu.setOptMode(mode);
+        CHECK(m.load(
+            "        MOV AL 80\n"
+            "        CMP AL 1\n"
+            "        JL less\n"
+            "        MOV EBX 1\n"
+            "less:   MOV ECX 1\n"));
+        CHECK(m.execute("RUN") == "RUN completed");
+        CHECK(m.regs.get(Reg::EBX) == 0);
+        CHECK(m.regs.get(Reg::ECX) == 1);
+    }
+}
+
+// Snapshots share stack pages with the live image, however deep the stack
+// has grown, and a write copies only the page it lands in
+void stack_snapshot_copy_on_write() {
+    Memory mem;
+    uint32_t deep = Memory::STACK_BASE + 8;
+    uint32_t top = Memory::STACK_TOP;
+    CHECK(mem.push(deep, 0x11));
+    CHECK(mem.push(top, 0x22));
+
+    Memory::Snapshot first = mem.snapshot();
+    Memory::Snapshot second = mem.snapshot();
+    CHECK(first.stack.size() == second.stack.size());
+    for (size_t i = 0; i < first.stack.size(); i++) CHECK(first.stack[i] == second.stack[i]);
+
+    mem.write(deep, 0x33);
+    Memory::Snapshot third = mem.snapshot();
+    CHECK(third.stack.back() != first.stack.back());    // The page under STACK_BASE was copied
+    CHECK(third.stack.front() == first.stack.front());  // The top page is still shared
+
+    mem.restore(first);
+    uint32_t val;
+    CHECK(mem.pop(deep, val) && val == 0x11);
+    CHECK(mem.pop(top, val) && val == 0x22);
+    mem.restore(third);
+    CHECK(mem.read(Memory::STACK_BASE + 4) == 0x33);
+}
+
+const struct {
+    const char* name;
+    void (*run)();
+} TESTS[] = {
+    {"jit_masks_guest_flags", jit_masks_guest_flags},
+    {"restore_checkpoint_taken_in_run", restore_checkpoint_taken_in_run},
+    {"append_after_source_with_data", append_after_source_with_data},
+    {"bad_line_not_recorded", bad_line_not_recorded},
+    {"compare_conditions", compare_conditions},
+    {"sub_register_flags", sub_register_flags},
+    {"stack_snapshot_copy_on_write", stack_snapshot_copy_on_write},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bool found = false;
+    for (const auto& test : TESTS) {
+        if (argc > 1 && std::strcmp(argv[1], test.name) != 0) continue;
+        found = true;
+        test.run();
+    }
+    if (!found) {
+        fprintf(stderr, "emulator_tests: no test %s\n", argv[1]);
+        return 2;
+    }
+    return failures ? 1 : 0;
+}